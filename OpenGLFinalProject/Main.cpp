@@ -4,13 +4,148 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <type_traits>
+#include <utility>
+#include <deque>
+#include <limits>
+#include <cstdio>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <gl/glut.h>
 
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#endif
+
 #define PI 3.14159
 
 using namespace std::chrono;
 void setDefaultLineWidth();
 
+// every heap allocation in the program goes through here, so benchmarks can count them
+std::atomic<uint64_t> heapAllocations{ 0 };
+
+// the replacements are kept out of line, inlined into their callers the compiler would see
+// memory from operator new handed to free and warn about every delete
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+NOINLINE void *countedAllocate(size_t size) noexcept {
+	heapAllocations++;
+	return malloc(size ? size : 1);
+}
+
+NOINLINE void countedFree(void *memory) noexcept {
+	free(memory);
+}
+
+void *operator new(size_t size) {
+	void *memory = countedAllocate(size);
+	if (!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void *operator new[](size_t size) {
+	void *memory = countedAllocate(size);
+	if (!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	return countedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return countedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept {
+	countedFree(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+	countedFree(memory);
+}
+
+void operator delete(void *memory, size_t size) noexcept {
+	countedFree(memory);
+}
+
+void operator delete[](void *memory, size_t size) noexcept {
+	countedFree(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+	countedFree(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+	countedFree(memory);
+}
+
+// how much memory the process has resident right now, in kilobytes
+long residentKilobytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return (long)(counters.WorkingSetSize / 1024);
+#else
+	// the second field of statm is the resident size in pages
+	long pages = 0;
+	std::ifstream statm("/proc/self/statm");
+	statm >> pages >> pages;
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+// the most memory the process ever had resident since it started, in kilobytes. it never goes down,
+// so after the first of several runs in one process it only says something about the largest of them
+long peakResidentKilobytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss; // already in kilobytes on Linux
+#endif
+}
+
 struct Vector2f {
 	float x;
 	float y;
@@ -22,6 +157,12 @@ struct Vector3f {
 	float z;
 };
 
+// a vertex with its own color, laid out for glVertexPointer/glColorPointer
+struct ColorVertex {
+	Vector2f pos;
+	Vector3f color;
+};
+
 float sqrDistance(Vector2f a, Vector2f b) {
 	float diffX = a.x - b.x;
 	float diffY = a.y - b.y;
@@ -32,15 +173,1375 @@ float distance(Vector2f a, Vector2f b) {
 	return sqrt(sqrDistance(a, b));
 }
 
+// SplitMix64's output function, every bit of x affects every bit of the result
+inline uint64_t splitMix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+// a random number between 0 and 2^31 - 1 that only depends on its inputs, not on any hidden state,
+// so the same seed and counter give the same number in any order, on any thread and on any platform
+inline int hashRandom(uint32_t seed, uint64_t counter) {
+	return (int)(splitMix64(splitMix64(seed) ^ counter) >> 33);
+}
+
+// 2D affine transform, x' = a * x + c * y + tx and y' = b * x + d * y + ty
+struct Matrix2f {
+	float a = 1, b = 0, c = 0, d = 1, tx = 0, ty = 0;
+	Vector2f apply(Vector2f p) const {
+		return{ a * p.x + c * p.y + tx, b * p.x + d * p.y + ty };
+	}
+	// returns this * m, so m is applied to the vertices first
+	Matrix2f multiply(const Matrix2f &m) const {
+		Matrix2f r;
+		r.a = a * m.a + c * m.b;
+		r.b = b * m.a + d * m.b;
+		r.c = a * m.c + c * m.d;
+		r.d = b * m.c + d * m.d;
+		r.tx = a * m.tx + c * m.ty + tx;
+		r.ty = b * m.tx + d * m.ty + ty;
+		return r;
+	}
+};
+
+thread_local int jobQueueIndex = 0; // which queue of the job system belongs to the running thread
+thread_local bool jobsInline = false; // set while a job runs a whole world, its own parallelFor calls then stay on its thread
+
+// a fixed set of worker threads with one job queue each, a thread takes work from the back
+// of its own queue and steals from the front of the others when its own runs dry
+struct JobSystem {
+	struct Job {
+		void(*invoke)(const void *work, int begin, int end);
+		const void *work;
+		int begin, end;
+		std::atomic<int> *pending;
+	};
+	struct JobQueue {
+		std::mutex mutex;
+		std::vector<Job> jobs; // reused between frames so queueing jobs does not allocate
+		size_t head = 0; // jobs before head were already stolen
+	};
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<JobQueue> > queues; // queue 0 belongs to the thread that called start
+	std::atomic<bool> quitting{ false };
+	std::atomic<int> queued{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+
+	~JobSystem() {
+		stop();
+	}
+	int threadCount() const {
+		return std::max((int)queues.size(), 1);
+	}
+	// threadCount includes the calling thread, which takes part in every parallelFor it starts
+	void start(int threadCount) {
+		stop();
+		threadCount = std::max(threadCount, 1);
+		for (int i = 0; i < threadCount; i++)
+			queues.push_back(std::unique_ptr<JobQueue>(new JobQueue));
+		jobQueueIndex = 0;
+		for (int i = 1; i < threadCount; i++)
+			workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+	}
+	void stop() {
+		quitting = true;
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeUp.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		workers.clear();
+		queues.clear();
+		quitting = false;
+	}
+	// calls work(begin, end) for consecutive ranges of at most grain items covering [0, count)
+	// and returns once all of them are done
+	template <typename Work>
+	void parallelFor(int count, int grain, const Work &work) {
+		if (count <= 0) return;
+		if (queues.size() <= 1 || count <= grain || jobsInline) {
+			work(0, count);
+			return;
+		}
+		std::atomic<int> pending((count + grain - 1) / grain);
+		JobQueue &own = *queues[jobQueueIndex];
+		{
+			std::lock_guard<std::mutex> lock(own.mutex);
+			for (int begin = 0; begin < count; begin += grain) {
+				Job job = { &invokeWork<Work>, &work, begin, std::min(begin + grain, count), &pending };
+				own.jobs.push_back(job);
+			}
+		}
+		queued += pending;
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeUp.notify_all();
+		// help out instead of blocking, this also keeps nested parallelFor calls from deadlocking
+		while (pending > 0) {
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+	template <typename Work>
+	static void invokeWork(const void *work, int begin, int end) {
+		(*(const Work*)work)(begin, end);
+	}
+	bool takeJob(JobQueue &queue, bool fromBack, Job &job) {
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.size() <= queue.head) return false;
+		if (fromBack) {
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else {
+			job = queue.jobs[queue.head++];
+		}
+		if (queue.jobs.size() <= queue.head) {
+			queue.jobs.clear();
+			queue.head = 0;
+		}
+		return true;
+	}
+	bool runOne() {
+		Job job;
+		int n = (int)queues.size();
+		bool found = takeJob(*queues[jobQueueIndex], true, job);
+		for (int i = 1; i < n && !found; i++)
+			found = takeJob(*queues[(jobQueueIndex + i) % n], false, job);
+		if (!found) return false;
+		queued--;
+		job.invoke(job.work, job.begin, job.end);
+		(*job.pending)--;
+		return true;
+	}
+	void workerLoop(int index) {
+		jobQueueIndex = index;
+		while (!quitting) {
+			if (runOne()) continue;
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wakeUp.wait(lock, [this] { return quitting || queued > 0; });
+		}
+	}
+};
+
+JobSystem jobs;
+
+// an axis aligned box in world space
+struct Bounds {
+	Vector2f min, max;
+	bool overlaps(const Bounds &other) const {
+		return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+	}
+	// the box around this one after rotating it by angle degrees about the origin and moving it by offset
+	Bounds transformed(Vector2f offset, float angle) const {
+		float rad = angle * PI / 180;
+		float c = cosf(rad), s = sinf(rad);
+		Vector2f center = { (min.x + max.x) / 2, (min.y + max.y) / 2 };
+		Vector2f half = { (max.x - min.x) / 2, (max.y - min.y) / 2 };
+		Vector2f turned = { c * center.x - s * center.y + offset.x, s * center.x + c * center.y + offset.y };
+		Vector2f extent = { fabsf(c) * half.x + fabsf(s) * half.y, fabsf(s) * half.x + fabsf(c) * half.y };
+		return{ { turned.x - extent.x, turned.y - extent.y }, { turned.x + extent.x, turned.y + extent.y } };
+	}
+};
+
+// a frame, what it draws with and what it counts belong to the thread drawing it, so that
+// worlds can be drawn side by side on different threads
+
+// the world rectangle the current frame shows, display sets it from the projection
+thread_local Bounds viewBounds = { { -1e30f, -1e30f }, { 1e30f, 1e30f } };
+
+// every vertex handed to a renderer is counted here, the profiler turns it into vertices per frame
+thread_local uint64_t verticesEmitted = 0;
+// drawables and shapes skipped because they were outside the view
+thread_local uint64_t itemsCulled = 0;
+// pixels the software renderer cleared and filled again, untouched tiles keep last frame's pixels
+thread_local uint64_t pixelsRepainted = 0;
+// calls that change a renderer's color, width or matrix, and calls that draw, counted by every renderer
+thread_local uint64_t stateChanges = 0;
+thread_local uint64_t drawCalls = 0;
+
+// everything the scene draws goes through here, so the same scene can be drawn
+// by OpenGL in a window or by the CPU into memory
+struct IRenderer {
+	virtual void clear(float r, float g, float b) = 0;
+	// replaces the current matrix with an orthographic projection of the given world rectangle
+	virtual void ortho2D(float left, float right, float bottom, float top) = 0;
+	virtual void pushMatrix() = 0;
+	virtual void popMatrix() = 0;
+	virtual void translate(float x, float y) = 0;
+	virtual void rotate(float angle) = 0; // in degrees, counter-clockwise
+	virtual void scale(float x, float y) = 0;
+	virtual void color(float r, float g, float b) = 0;
+	virtual void lineWidth(float width) = 0;
+	virtual void pointSize(float size) = 0;
+	// immediate mode, the primitives are the same as glBegin
+	virtual void begin(int primitive) = 0;
+	virtual void vertex(float x, float y) = 0;
+	virtual void end() = 0;
+	// draws vertices that already carry their own color
+	virtual void drawArrays(int primitive, const ColorVertex *vertices, int count) = 0;
+	virtual void swapBuffers() = 0;
+};
+
+struct GLRenderer : public IRenderer {
+	void clear(float r, float g, float b) {
+		glClearColor(r, g, b, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	void ortho2D(float left, float right, float bottom, float top) {
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+		gluOrtho2D(left, right, bottom, top);
+	}
+	void pushMatrix() {
+		stateChanges++;
+		glPushMatrix();
+	}
+	void popMatrix() {
+		stateChanges++;
+		glPopMatrix();
+	}
+	void translate(float x, float y) {
+		stateChanges++;
+		glTranslatef(x, y, 0);
+	}
+	void rotate(float angle) {
+		stateChanges++;
+		glRotatef(angle, 0, 0, 1);
+	}
+	void scale(float x, float y) {
+		stateChanges++;
+		glScalef(x, y, 1);
+	}
+	void color(float r, float g, float b) {
+		stateChanges++;
+		glColor3f(r, g, b);
+	}
+	void lineWidth(float width) {
+		stateChanges++;
+		glLineWidth(width);
+	}
+	void pointSize(float size) {
+		stateChanges++;
+		glPointSize(size);
+	}
+	void begin(int primitive) {
+		glBegin(primitive);
+	}
+	void vertex(float x, float y) {
+		verticesEmitted++;
+		glVertex2f(x, y);
+	}
+	void end() {
+		drawCalls++;
+		glEnd();
+	}
+	void drawArrays(int primitive, const ColorVertex *vertices, int count) {
+		drawCalls++;
+		if (count <= 0) return;
+		verticesEmitted += count;
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(2, GL_FLOAT, sizeof(ColorVertex), &vertices[0].pos);
+		glColorPointer(3, GL_FLOAT, sizeof(ColorVertex), &vertices[0].color);
+		glDrawArrays(primitive, 0, count);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+	}
+	void swapBuffers() {
+		glutSwapBuffers();
+	}
+};
+
+const int DIRTY_TILE_SIZE = 32; // in pixels, the software renderer repaints whole tiles
+bool DIRTY_TRACKING = true; // false repaints every tile every frame, for comparing
+
+// rasterizes into an in-memory RGBA framebuffer, no window or GPU needed
+struct SoftwareRenderer : public IRenderer {
+	int width, height;
+	std::vector<uint32_t> pixels; // RGBA, one byte each, top row first
+	std::vector<Matrix2f> matrices = { Matrix2f() };
+	Vector3f currentColor = { 1, 1, 1 };
+	float currentLineWidth = 1;
+	float currentPointSize = 1;
+	int primitive;
+	std::vector<ColorVertex> pending; // screen space vertices between begin and end
+	int framesDrawn = 0;
+	// the frame is only recorded until swapBuffers, then every tile whose clear color and
+	// primitives hash the same as last frame keeps its pixels and the others are drawn again
+	struct Command {
+		int primitive;
+		int first, count; // into frameVertices
+		float lineWidth, pointSize;
+		int tileX0, tileY0, tileX1, tileY1; // the tiles its screen box touches
+	};
+	std::vector<ColorVertex> frameVertices;
+	std::vector<Command> commands;
+	bool cleared = false;
+	uint32_t clearColor = 0;
+	int tileColumns, tileRows;
+	std::vector<uint64_t> tileHashes, previousTileHashes; // previous is empty when nothing can be kept
+	std::vector<int> tileStart, tileFill, tileCommands; // commands of the dirty tiles, bucketed by tile
+	std::vector<int> dirtyList;
+	bool dirtyTracking = DIRTY_TRACKING;
+	int dirtyTiles = 0; // in the last frame
+	// the pixels a primitive may write, inclusive. a tile's own rectangle when tiles are drawn one by one
+	struct Scissor {
+		int x0, y0, x1, y1;
+	};
+	SoftwareRenderer(int width, int height) : width(width), height(height), pixels(width * height) {
+		tileColumns = (width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+		tileRows = (height + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE;
+		tileHashes.resize(tileColumns * tileRows);
+	}
+	static uint32_t pack(Vector3f c) {
+		uint32_t r = (uint32_t)(std::min(std::max(c.x, 0.0f), 1.0f) * 255 + 0.5f);
+		uint32_t g = (uint32_t)(std::min(std::max(c.y, 0.0f), 1.0f) * 255 + 0.5f);
+		uint32_t b = (uint32_t)(std::min(std::max(c.z, 0.0f), 1.0f) * 255 + 0.5f);
+		return r | g << 8 | b << 16 | 0xff000000u;
+	}
+	// one row of a triangle. pixel x is inside when all three weights base + step * (x - left)
+	// are at least 0, and gets the vertex colors mixed by them
+	struct TriangleSpan {
+		float left;
+		float base[3], step[3];
+		Vector3f color[3];
+	};
+	// with SIMD every pixel of the span goes through the vector code, the last block masked, so a pixel
+	// comes out the same wherever the span was cut by a tile. the vector code does the scalar arithmetic in the
+	// same order, so the pixels match the scalar fill bit for bit
+	static void fillTriangleSpan(uint32_t *row, int x0, int x1, const TriangleSpan &span) {
+		int x = x0;
+#if defined(SIMD_AVX2)
+		__m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), left = _mm256_set1_ps(span.left);
+		__m256 base0 = _mm256_set1_ps(span.base[0]), base1 = _mm256_set1_ps(span.base[1]), base2 = _mm256_set1_ps(span.base[2]);
+		__m256 step0 = _mm256_set1_ps(span.step[0]), step1 = _mm256_set1_ps(span.step[1]), step2 = _mm256_set1_ps(span.step[2]);
+		__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1), scale = _mm256_set1_ps(255), half = _mm256_set1_ps(0.5f);
+		__m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), alpha = _mm256_set1_epi32((int)0xff000000u);
+		for (; x <= x1; x += 8) {
+			__m256 k = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lane), left);
+			__m256 w0 = _mm256_add_ps(base0, _mm256_mul_ps(step0, k));
+			__m256 w1 = _mm256_add_ps(base1, _mm256_mul_ps(step1, k));
+			__m256 w2 = _mm256_add_ps(base2, _mm256_mul_ps(step2, k));
+			__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ), _mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+				_mm256_cmp_ps(w2, zero, _CMP_GE_OQ));
+			__m256i mask = _mm256_and_si256(_mm256_castps_si256(inside), _mm256_cmpgt_epi32(_mm256_set1_epi32(x1 - x + 1), laneIndex));
+			if (_mm256_testz_si256(mask, mask)) continue;
+			__m256i rgba = alpha;
+			for (int channel = 0; channel < 3; channel++) {
+				const float *c0 = &span.color[0].x, *c1 = &span.color[1].x, *c2 = &span.color[2].x;
+				__m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, _mm256_set1_ps(c0[channel])), _mm256_mul_ps(w1, _mm256_set1_ps(c1[channel]))),
+					_mm256_mul_ps(w2, _mm256_set1_ps(c2[channel])));
+				c = _mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c, zero), one), scale), half);
+				rgba = _mm256_or_si256(rgba, _mm256_slli_epi32(_mm256_cvttps_epi32(c), channel * 8));
+			}
+			_mm256_maskstore_epi32((int *)(row + x), mask, rgba);
+		}
+#elif defined(SIMD_SSE2)
+		__m128 lane = _mm_setr_ps(0, 1, 2, 3), left = _mm_set1_ps(span.left);
+		__m128 base0 = _mm_set1_ps(span.base[0]), base1 = _mm_set1_ps(span.base[1]), base2 = _mm_set1_ps(span.base[2]);
+		__m128 step0 = _mm_set1_ps(span.step[0]), step1 = _mm_set1_ps(span.step[1]), step2 = _mm_set1_ps(span.step[2]);
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1), scale = _mm_set1_ps(255), half = _mm_set1_ps(0.5f);
+		__m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3), alpha = _mm_set1_epi32((int)0xff000000u);
+		for (; x <= x1; x += 4) {
+			__m128 k = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), left);
+			__m128 w0 = _mm_add_ps(base0, _mm_mul_ps(step0, k));
+			__m128 w1 = _mm_add_ps(base1, _mm_mul_ps(step1, k));
+			__m128 w2 = _mm_add_ps(base2, _mm_mul_ps(step2, k));
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			__m128i mask = _mm_and_si128(_mm_castps_si128(inside), _mm_cmpgt_epi32(_mm_set1_epi32(x1 - x + 1), laneIndex));
+			int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+			if (bits == 0) continue;
+			__m128i rgba = alpha;
+			for (int channel = 0; channel < 3; channel++) {
+				const float *c0 = &span.color[0].x, *c1 = &span.color[1].x, *c2 = &span.color[2].x;
+				__m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(c0[channel])), _mm_mul_ps(w1, _mm_set1_ps(c1[channel]))),
+					_mm_mul_ps(w2, _mm_set1_ps(c2[channel])));
+				c = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c, zero), one), scale), half);
+				rgba = _mm_or_si128(rgba, _mm_slli_epi32(_mm_cvttps_epi32(c), channel * 8));
+			}
+			if (bits == 0xf)
+				_mm_storeu_si128((__m128i *)(row + x), rgba);
+			else {
+				// no masked store before AVX, and reading past x1 could leave the framebuffer
+				uint32_t out[4];
+				_mm_storeu_si128((__m128i *)out, rgba);
+				for (int i = 0; i < 4; i++)
+					if (bits >> i & 1) row[x + i] = out[i];
+			}
+		}
+#endif
+		for (; x <= x1; x++) {
+			float k = x - span.left;
+			float w0 = span.base[0] + span.step[0] * k, w1 = span.base[1] + span.step[1] * k, w2 = span.base[2] + span.step[2] * k;
+			if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+				Vector3f c = {
+					w0 * span.color[0].x + w1 * span.color[1].x + w2 * span.color[2].x,
+					w0 * span.color[0].y + w1 * span.color[1].y + w2 * span.color[2].y,
+					w0 * span.color[0].z + w1 * span.color[1].z + w2 * span.color[2].z
+				};
+				row[x] = pack(c);
+			}
+		}
+	}
+	// everything recorded so far is covered anyway
+	void clear(float r, float g, float b) {
+		clearColor = pack({ r, g, b });
+		cleared = true;
+		commands.clear();
+		frameVertices.clear();
+		std::fill(tileHashes.begin(), tileHashes.end(), splitMix64(clearColor));
+	}
+	void ortho2D(float left, float right, float bottom, float top) {
+		// world to pixel coordinates, pixel rows go downward
+		Matrix2f m;
+		m.a = width / (right - left);
+		m.d = -height / (top - bottom);
+		m.tx = -left * m.a;
+		m.ty = -top * m.d;
+		matrices.back() = m;
+	}
+	void pushMatrix() {
+		stateChanges++;
+		matrices.push_back(matrices.back());
+	}
+	void popMatrix() {
+		stateChanges++;
+		if (matrices.size() > 1) matrices.pop_back();
+	}
+	void translate(float x, float y) {
+		stateChanges++;
+		Matrix2f m;
+		m.tx = x;
+		m.ty = y;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void rotate(float angle) {
+		stateChanges++;
+		float rad = angle * PI / 180;
+		Matrix2f m;
+		m.a = m.d = cosf(rad);
+		m.b = sinf(rad);
+		m.c = -m.b;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void scale(float x, float y) {
+		stateChanges++;
+		Matrix2f m;
+		m.a = x;
+		m.d = y;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void color(float r, float g, float b) {
+		stateChanges++;
+		currentColor = { r, g, b };
+	}
+	void lineWidth(float width) {
+		stateChanges++;
+		currentLineWidth = width;
+	}
+	void pointSize(float size) {
+		stateChanges++;
+		currentPointSize = size;
+	}
+	void begin(int primitive) {
+		this->primitive = primitive;
+		pending.clear();
+	}
+	void vertex(float x, float y) {
+		verticesEmitted++;
+		pending.push_back({ matrices.back().apply({ x, y }), currentColor });
+	}
+	void end() {
+		drawCalls++;
+		if (!pending.empty())
+			record(primitive, &pending[0], (int)pending.size());
+	}
+	void drawArrays(int primitive, const ColorVertex *vertices, int count) {
+		drawCalls++;
+		if (count <= 0) return;
+		verticesEmitted += count;
+		const Matrix2f &m = matrices.back();
+		size_t first = frameVertices.size();
+		frameVertices.resize(first + count);
+		for (int i = 0; i < count; i++)
+			frameVertices[first + i] = { m.apply(vertices[i].pos), vertices[i].color };
+		addCommand(primitive, (int)first, count);
+	}
+	void record(int primitive, const ColorVertex *v, int count) {
+		size_t first = frameVertices.size();
+		frameVertices.insert(frameVertices.end(), v, v + count);
+		addCommand(primitive, (int)first, count);
+	}
+	// mixes 8 bytes at a time, equal hashes are taken as equal contents
+	static uint64_t hashBytes(const void *data, size_t size, uint64_t h) {
+		const unsigned char *bytes = (const unsigned char *)data;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			h = splitMix64(h ^ word);
+		}
+		uint64_t rest = 0;
+		memcpy(&rest, bytes + i, size - i);
+		return splitMix64(h ^ rest ^ size);
+	}
+	// big batches are split into runs of nearby primitives, so every tile only replays the runs that
+	// reach it. a run ends after RUN_PRIMITIVES or once its box would grow past two tiles, which also
+	// keeps the jump between two shapes of one batch from making a run that crosses the screen
+	void addCommand(int primitive, int first, int count) {
+		int stride, shared; // vertices per primitive and vertices a run shares with the next one
+		switch (primitive) {
+		case GL_POINTS: stride = 1; shared = 0; break;
+		case GL_LINES: stride = 2; shared = 0; break;
+		case GL_TRIANGLES: stride = 3; shared = 0; break;
+		case GL_QUADS: stride = 4; shared = 0; break;
+		case GL_LINE_STRIP: stride = 1; shared = 1; break;
+		case GL_TRIANGLE_STRIP: stride = 1; shared = 2; break;
+		default: addRun(primitive, first, count, boxOf(&frameVertices[first], count)); return; // loops and fans need all their vertices
+		}
+		const int RUN_PRIMITIVES = 16;
+		const float RUN_EXTENT = 2 * DIRTY_TILE_SIZE;
+		int primitives = (count - shared) / stride;
+		int runStart = 0;
+		Bounds run = { { 0, 0 }, { 0, 0 } };
+		for (int i = 0; i < primitives; i++) {
+			Bounds box = boxOf(&frameVertices[first + i * stride], stride + shared);
+			if (i > runStart) {
+				Bounds joined = { { std::min(run.min.x, box.min.x), std::min(run.min.y, box.min.y) },
+					{ std::max(run.max.x, box.max.x), std::max(run.max.y, box.max.y) } };
+				if (i - runStart < RUN_PRIMITIVES && joined.max.x - joined.min.x <= RUN_EXTENT && joined.max.y - joined.min.y <= RUN_EXTENT) {
+					run = joined;
+					continue;
+				}
+				addRun(primitive, first + runStart * stride, (i - runStart) * stride + shared, run);
+			}
+			runStart = i;
+			run = box;
+		}
+		if (primitives > runStart)
+			addRun(primitive, first + runStart * stride, (primitives - runStart) * stride + shared, run);
+	}
+	// min and max would lose a nan, so a vertex that is not finite makes the whole box endless instead
+	static Bounds boxOf(const ColorVertex *v, int count) {
+		Bounds box = { v[0].pos, v[0].pos };
+		for (int i = 0; i < count; i++) {
+			if (!std::isfinite(v[i].pos.x) || !std::isfinite(v[i].pos.y)) {
+				float endless = std::numeric_limits<float>::infinity();
+				Bounds all = { { -endless, -endless }, { endless, endless } };
+				return all;
+			}
+			box.min.x = std::min(box.min.x, v[i].pos.x);
+			box.max.x = std::max(box.max.x, v[i].pos.x);
+			box.min.y = std::min(box.min.y, v[i].pos.y);
+			box.max.y = std::max(box.max.y, v[i].pos.y);
+		}
+		return box;
+	}
+	// box is around the run's vertices in pixels
+	void addRun(int primitive, int first, int count, Bounds box) {
+		// lines and points reach out by half their width around the vertices
+		float pad = std::max(std::max(currentLineWidth, currentPointSize), 1.0f) / 2 + 1;
+		const ColorVertex *v = &frameVertices[first];
+		float minX = box.min.x, maxX = box.max.x, minY = box.min.y, maxY = box.max.y;
+		// written so that a nan box is off screen too
+		if (!(maxX + pad >= 0 && maxY + pad >= 0 && minX - pad < width && minY - pad < height))
+			return; // off screen
+		if (!std::isfinite(minX) || !std::isfinite(maxX) || !std::isfinite(minY) || !std::isfinite(maxY))
+			return; // a vertex that is not finite, nothing can be drawn from it
+		Command command = { primitive, first, count, currentLineWidth, currentPointSize,
+			std::min((int)std::max(minX - pad, 0.0f) / DIRTY_TILE_SIZE, tileColumns - 1),
+			std::min((int)std::max(minY - pad, 0.0f) / DIRTY_TILE_SIZE, tileRows - 1),
+			std::min((int)std::min(maxX + pad, width - 1.0f) / DIRTY_TILE_SIZE, tileColumns - 1),
+			std::min((int)std::min(maxY + pad, height - 1.0f) / DIRTY_TILE_SIZE, tileRows - 1) };
+		commands.push_back(command);
+		if (!cleared) return;
+		float widths[2] = { currentLineWidth, currentPointSize };
+		uint64_t hash = hashBytes(widths, sizeof(widths), splitMix64((uint64_t)primitive));
+		hash = hashBytes(v, count * sizeof(ColorVertex), hash);
+		// the order commands are mixed in matters, like the order they are drawn in
+		for (int ty = command.tileY0; ty <= command.tileY1; ty++)
+			for (int tx = command.tileX0; tx <= command.tileX1; tx++) {
+				uint64_t &tile = tileHashes[ty * tileColumns + tx];
+				tile = splitMix64(tile * 31 + hash);
+			}
+	}
+	void swapBuffers() {
+		Scissor full = { 0, 0, width - 1, height - 1 };
+		if (cleared)
+			repaintDirtyTiles();
+		else {
+			// drawn over whatever was there, so nothing is known about next frame's tiles
+			for (size_t i = 0; i < commands.size(); i++)
+				rasterize(commands[i], full);
+			pixelsRepainted += pixels.size();
+			previousTileHashes.clear();
+		}
+		commands.clear();
+		frameVertices.clear();
+		cleared = false;
+		framesDrawn++;
+	}
+	bool isTileDirty(int tile) const {
+		return !dirtyTracking || previousTileHashes.empty() || tileHashes[tile] != previousTileHashes[tile];
+	}
+	void repaintDirtyTiles() {
+		int tiles = tileColumns * tileRows;
+		dirtyList.clear();
+		for (int t = 0; t < tiles; t++)
+			if (isTileDirty(t)) dirtyList.push_back(t);
+		dirtyTiles = (int)dirtyList.size();
+		// a primitive is set up again for every tile it touches, so on one thread a frame that
+		// mostly changed is cheaper in one pass. with more threads the tiles are drawn side by side
+		if (jobs.threadCount() == 1 && dirtyTiles * 2 > tiles) {
+			Scissor full = { 0, 0, width - 1, height - 1 };
+			std::fill(pixels.begin(), pixels.end(), clearColor);
+			for (size_t i = 0; i < commands.size(); i++)
+				rasterize(commands[i], full);
+			pixelsRepainted += pixels.size();
+			previousTileHashes = tileHashes;
+			return;
+		}
+		// count the commands of every dirty tile, then place them, so each tile gets its slice in draw order
+		tileStart.assign(tiles + 1, 0);
+		for (size_t i = 0; i < commands.size(); i++) {
+			const Command &c = commands[i];
+			for (int ty = c.tileY0; ty <= c.tileY1; ty++)
+				for (int tx = c.tileX0; tx <= c.tileX1; tx++)
+					if (isTileDirty(ty * tileColumns + tx)) tileStart[ty * tileColumns + tx + 1]++;
+		}
+		for (int t = 0; t < tiles; t++)
+			tileStart[t + 1] += tileStart[t];
+		tileCommands.resize(tileStart[tiles]);
+		tileFill.assign(tileStart.begin(), tileStart.end() - 1);
+		for (size_t i = 0; i < commands.size(); i++) {
+			const Command &c = commands[i];
+			for (int ty = c.tileY0; ty <= c.tileY1; ty++)
+				for (int tx = c.tileX0; tx <= c.tileX1; tx++)
+					if (isTileDirty(ty * tileColumns + tx)) tileCommands[tileFill[ty * tileColumns + tx]++] = (int)i;
+		}
+		previousTileHashes = tileHashes;
+		jobs.parallelFor(dirtyTiles, 1, [this](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				repaintTile(dirtyList[i]);
+		});
+		for (int i = 0; i < dirtyTiles; i++) {
+			Scissor tile = tileScissor(dirtyList[i]);
+			pixelsRepainted += (tile.x1 - tile.x0 + 1) * (tile.y1 - tile.y0 + 1);
+		}
+	}
+	Scissor tileScissor(int tile) const {
+		int x0 = tile % tileColumns * DIRTY_TILE_SIZE, y0 = tile / tileColumns * DIRTY_TILE_SIZE;
+		return{ x0, y0, std::min(x0 + DIRTY_TILE_SIZE, width) - 1, std::min(y0 + DIRTY_TILE_SIZE, height) - 1 };
+	}
+	// tiles share no pixels, so any number of them can be repainted at once
+	void repaintTile(int tile) {
+		Scissor scissor = tileScissor(tile);
+		for (int y = scissor.y0; y <= scissor.y1; y++)
+			std::fill(&pixels[y * width + scissor.x0], &pixels[y * width + scissor.x1] + 1, clearColor);
+		for (int i = tileStart[tile]; i < tileStart[tile + 1]; i++)
+			rasterize(commands[tileCommands[i]], scissor);
+	}
+	void rasterize(const Command &command, const Scissor &s) {
+		const ColorVertex *v = &frameVertices[command.first];
+		int count = command.count;
+		switch (command.primitive) {
+		case GL_POINTS:
+			for (int i = 0; i < count; i++)
+				fillPoint(v[i], command.pointSize, s);
+			break;
+		case GL_LINES:
+			for (int i = 0; i + 1 < count; i += 2)
+				fillLine(v[i], v[i + 1], command.lineWidth, s);
+			break;
+		case GL_LINE_STRIP:
+		case GL_LINE_LOOP:
+			for (int i = 0; i + 1 < count; i++)
+				fillLine(v[i], v[i + 1], command.lineWidth, s);
+			if (command.primitive == GL_LINE_LOOP && count > 2)
+				fillLine(v[count - 1], v[0], command.lineWidth, s);
+			break;
+		case GL_TRIANGLES:
+			for (int i = 0; i + 2 < count; i += 3)
+				fillTriangle(v[i], v[i + 1], v[i + 2], s);
+			break;
+		case GL_TRIANGLE_STRIP:
+			for (int i = 0; i + 2 < count; i++)
+				fillTriangle(v[i], v[i + 1], v[i + 2], s);
+			break;
+		case GL_POLYGON:
+		case GL_TRIANGLE_FAN:
+			// only convex polygons are drawn by the scene, so a fan is enough
+			for (int i = 1; i + 1 < count; i++)
+				fillTriangle(v[0], v[i], v[i + 1], s);
+			break;
+		case GL_QUADS:
+			for (int i = 0; i + 3 < count; i += 4) {
+				fillTriangle(v[i], v[i + 1], v[i + 2], s);
+				fillTriangle(v[i], v[i + 2], v[i + 3], s);
+			}
+			break;
+		}
+	}
+	void fillPoint(const ColorVertex &p, float size, const Scissor &s) {
+		float half = size / 2;
+		ColorVertex a = { { p.pos.x - half, p.pos.y - half }, p.color };
+		ColorVertex b = { { p.pos.x + half, p.pos.y - half }, p.color };
+		ColorVertex c = { { p.pos.x + half, p.pos.y + half }, p.color };
+		ColorVertex d = { { p.pos.x - half, p.pos.y + half }, p.color };
+		fillTriangle(a, b, c, s);
+		fillTriangle(a, c, d, s);
+	}
+	// a line is a quad as wide as the line width in pixels, like glLineWidth
+	void fillLine(const ColorVertex &p0, const ColorVertex &p1, float width, const Scissor &s) {
+		float reach = std::max(width, 1.0f) / 2 + 1;
+		if (std::max(p0.pos.x, p1.pos.x) + reach < s.x0 || std::min(p0.pos.x, p1.pos.x) - reach > s.x1 + 1 ||
+			std::max(p0.pos.y, p1.pos.y) + reach < s.y0 || std::min(p0.pos.y, p1.pos.y) - reach > s.y1 + 1)
+			return;
+		float dx = p1.pos.x - p0.pos.x, dy = p1.pos.y - p0.pos.y;
+		float len = sqrtf(dx * dx + dy * dy);
+		if (len == 0) return;
+		float half = std::max(width, 1.0f) / 2;
+		float nx = -dy / len * half, ny = dx / len * half;
+		ColorVertex a = { { p0.pos.x - nx, p0.pos.y - ny }, p0.color };
+		ColorVertex b = { { p0.pos.x + nx, p0.pos.y + ny }, p0.color };
+		ColorVertex c = { { p1.pos.x + nx, p1.pos.y + ny }, p1.color };
+		ColorVertex d = { { p1.pos.x - nx, p1.pos.y - ny }, p1.color };
+		fillTriangle(a, b, c, s);
+		fillTriangle(a, c, d, s);
+	}
+	// edge function, positive when p is on the left of a->b
+	static float edge(Vector2f a, Vector2f b, float px, float py) {
+		return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+	}
+	void fillTriangle(const ColorVertex &v0, const ColorVertex &v1, const ColorVertex &v2, const Scissor &s) {
+		float minX = std::min(v0.pos.x, std::min(v1.pos.x, v2.pos.x));
+		float maxX = std::max(v0.pos.x, std::max(v1.pos.x, v2.pos.x));
+		float minY = std::min(v0.pos.y, std::min(v1.pos.y, v2.pos.y));
+		float maxY = std::max(v0.pos.y, std::max(v1.pos.y, v2.pos.y));
+		// the same test as ceil(max) >= s.x0 and floor(min) <= s.x1, but false for a nan
+		if (!(maxX > s.x0 - 1 && minX < s.x1 + 1 && maxY > s.y0 - 1 && minY < s.y1 + 1)) return;
+		// clamped before the cast, a far away vertex does not fit an int
+		int x0 = (int)std::max(floorf(minX), (float)s.x0), x1 = (int)std::min(ceilf(maxX), (float)s.x1);
+		int y0 = (int)std::max(floorf(minY), (float)s.y0), y1 = (int)std::min(ceilf(maxY), (float)s.y1);
+		if (x0 > x1 || y0 > y1) return;
+		float area = edge(v0.pos, v1.pos, v2.pos.x, v2.pos.y);
+		if (area == 0) return;
+		// barycentric weights change linearly along each row. they are measured from the triangle's own
+		// left edge instead of the clipped one, so a pixel gets the same color whatever tile draws it
+		float inv = 1 / area;
+		TriangleSpan span;
+		span.left = floorf(minX);
+		span.step[0] = -(v2.pos.y - v1.pos.y) * inv;
+		span.step[1] = -(v0.pos.y - v2.pos.y) * inv;
+		span.step[2] = -(v1.pos.y - v0.pos.y) * inv;
+		span.color[0] = v0.color;
+		span.color[1] = v1.color;
+		span.color[2] = v2.color;
+		for (int y = y0; y <= y1; y++) {
+			float px = span.left + 0.5f, py = y + 0.5f;
+			span.base[0] = edge(v1.pos, v2.pos, px, py) * inv;
+			span.base[1] = edge(v2.pos, v0.pos, px, py) * inv;
+			span.base[2] = edge(v0.pos, v1.pos, px, py) * inv;
+			fillTriangleSpan(&pixels[y * width], x0, x1, span);
+		}
+	}
+	bool writePPM(const char *path) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) return false;
+		file << "P6\n" << width << " " << height << "\n255\n";
+		std::vector<char> rgb(width * height * 3);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			rgb[i * 3] = (char)(pixels[i] & 0xff);
+			rgb[i * 3 + 1] = (char)(pixels[i] >> 8 & 0xff);
+			rgb[i * 3 + 2] = (char)(pixels[i] >> 16 & 0xff);
+		}
+		file.write(&rgb[0], rgb.size());
+		return (bool)file;
+	}
+	// trades the finished frame for another buffer together with the tile hashes of what that buffer holds,
+	// so drawing over an older frame still keeps the tiles it has in common with the new one.
+	// an empty buffer comes back cleared and with no hashes, so every tile of it is drawn
+	void exchangeFramebuffer(std::vector<uint32_t> &other, std::vector<uint64_t> &otherHashes) {
+		pixels.swap(other);
+		previousTileHashes.swap(otherHashes);
+		if (pixels.size() != (size_t)width * height) {
+			pixels.assign(width * height, 0);
+			previousTileHashes.clear();
+		}
+	}
+};
+
+// draws nothing, for measuring everything but the drawing itself
+struct NullRenderer : public IRenderer {
+	int framesDrawn = 0;
+	void clear(float r, float g, float b) {}
+	void ortho2D(float left, float right, float bottom, float top) {}
+	void pushMatrix() {
+		stateChanges++;
+	}
+	void popMatrix() {
+		stateChanges++;
+	}
+	void translate(float x, float y) {
+		stateChanges++;
+	}
+	void rotate(float angle) {
+		stateChanges++;
+	}
+	void scale(float x, float y) {
+		stateChanges++;
+	}
+	void color(float r, float g, float b) {
+		stateChanges++;
+	}
+	void lineWidth(float width) {
+		stateChanges++;
+	}
+	void pointSize(float size) {
+		stateChanges++;
+	}
+	void begin(int primitive) {}
+	void vertex(float x, float y) {
+		verticesEmitted++;
+	}
+	void end() {
+		drawCalls++;
+	}
+	void drawArrays(int primitive, const ColorVertex *vertices, int count) {
+		drawCalls++;
+		verticesEmitted += std::max(count, 0);
+	}
+	void swapBuffers() {
+		framesDrawn++;
+	}
+};
+
+bool BATCH_DRAWS = true; // false hands every call straight to the backend, for comparing
+
+// collects what the scene draws in a frame and hands it to a backend as a few large draws. vertices are
+// moved into world space here, every primitive becomes a list of triangles, lines or points, and the
+// commands are ordered by layer, then kind, then width, keeping the order they came in among equals
+struct RenderQueue : public IRenderer {
+	enum { KIND_TRIANGLES, KIND_LINES, KIND_POINTS }; // fills first, so outlines and points stay on top
+	struct Command {
+		uint64_t key; // layer, kind, then the width bits, which sort like the widths for positive floats
+		int first, count; // into vertices
+	};
+	IRenderer *backend = NULL;
+	std::vector<Matrix2f> matrices = { Matrix2f() };
+	Vector3f currentColor = { 1, 1, 1 };
+	float currentLineWidth = 1;
+	float currentPointSize = 1;
+	int primitive;
+	int layer = 0;
+	std::vector<ColorVertex> pending; // between begin and end, for the kinds that are listed at the end
+	int streamed = 0; // vertices given since begin
+	size_t streamStart = 0;
+	ColorVertex firstVertex, lastVertex;
+	std::vector<ColorVertex> vertices; // every list of the frame in world space, only grows
+	size_t used = 0; // how much of vertices the frame has filled
+	std::vector<Command> commands;
+	std::vector<ColorVertex> batch;
+	// drawing order between layers is kept as it is, display starts a layer for every kind of drawable
+	// and a drawable may start more of its own
+	void setLayer(int layer) {
+		this->layer = layer;
+	}
+	void clear(float r, float g, float b) {
+		commands.clear();
+		used = 0;
+		backend->clear(r, g, b);
+	}
+	// the backend keeps the projection, the queue only the model matrices
+	void ortho2D(float left, float right, float bottom, float top) {
+		flush();
+		backend->ortho2D(left, right, bottom, top);
+		matrices.resize(1);
+		matrices.back() = Matrix2f();
+	}
+	void pushMatrix() {
+		matrices.push_back(matrices.back());
+	}
+	void popMatrix() {
+		if (matrices.size() > 1) matrices.pop_back();
+	}
+	void translate(float x, float y) {
+		Matrix2f m;
+		m.tx = x;
+		m.ty = y;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void rotate(float angle) {
+		float rad = angle * PI / 180;
+		Matrix2f m;
+		m.a = m.d = cosf(rad);
+		m.b = sinf(rad);
+		m.c = -m.b;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void scale(float x, float y) {
+		Matrix2f m;
+		m.a = x;
+		m.d = y;
+		matrices.back() = matrices.back().multiply(m);
+	}
+	void color(float r, float g, float b) {
+		currentColor = { r, g, b };
+	}
+	void lineWidth(float width) {
+		currentLineWidth = width;
+	}
+	void pointSize(float size) {
+		currentPointSize = size;
+	}
+	// strips, loops and fans are turned into lists while their vertices come in, the rest waits for end
+	void begin(int primitive) {
+		this->primitive = primitive;
+		pending.clear();
+		streamed = 0;
+		streamStart = used;
+	}
+	void vertex(float x, float y) {
+		ColorVertex v = { matrices.back().apply({ x, y }), currentColor };
+		switch (primitive) {
+		case GL_LINE_STRIP:
+		case GL_LINE_LOOP:
+			if (streamed == 0)
+				firstVertex = v;
+			else {
+				ColorVertex *out = grow(2);
+				out[0] = lastVertex;
+				out[1] = v;
+			}
+			break;
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON:
+			if (streamed == 0)
+				firstVertex = v;
+			else if (streamed >= 2) {
+				ColorVertex *out = grow(3);
+				out[0] = firstVertex;
+				out[1] = lastVertex;
+				out[2] = v;
+			}
+			break;
+		default:
+			pending.push_back(v);
+			break;
+		}
+		lastVertex = v;
+		streamed++;
+	}
+	void end() {
+		switch (primitive) {
+		case GL_LINE_STRIP:
+		case GL_LINE_LOOP:
+			if (primitive == GL_LINE_LOOP && streamed > 2) {
+				ColorVertex *out = grow(2);
+				out[0] = lastVertex;
+				out[1] = firstVertex;
+			}
+			queue(KIND_LINES, currentLineWidth, streamStart);
+			break;
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON:
+			queue(KIND_TRIANGLES, 0, streamStart);
+			break;
+		default:
+			if (!pending.empty())
+				add(primitive, &pending[0], (int)pending.size(), false);
+			break;
+		}
+	}
+	void drawArrays(int primitive, const ColorVertex *vertices, int count) {
+		if (count > 0)
+			add(primitive, vertices, count, true);
+	}
+	// room for count more vertices at the end of the frame's lists. resizing would zero what is
+	// about to be written, so the buffer only grows past the largest frame so far
+	ColorVertex *grow(int count) {
+		size_t first = used;
+		used += count;
+		if (vertices.size() < used)
+			vertices.resize(std::max(used, vertices.size() * 2));
+		return &vertices[first];
+	}
+	// makes the vertices from first on a command, joined to the last one when the state is the same
+	void queue(int kind, float width, size_t first) {
+		if (used == first) return;
+		uint32_t widthBits;
+		memcpy(&widthBits, &width, sizeof(widthBits));
+		uint64_t key = (uint64_t)layer << 34 | (uint64_t)kind << 32 | widthBits;
+		int count = (int)(used - first);
+		// runs of the same state are joined right away, sorting only has to move what is left
+		if (!commands.empty() && commands.back().key == key)
+			commands.back().count += count;
+		else
+			commands.push_back({ key, (int)first, count });
+	}
+	// writes the primitive as a list, the same triangles and segments a backend would have drawn
+	void add(int primitive, const ColorVertex *v, int count, bool transform) {
+		int kind = KIND_TRIANGLES, listed;
+		float width = 0;
+		switch (primitive) {
+		case GL_POINTS: kind = KIND_POINTS; width = currentPointSize; listed = count; break;
+		case GL_LINES: kind = KIND_LINES; width = currentLineWidth; listed = count / 2 * 2; break;
+		case GL_LINE_STRIP: kind = KIND_LINES; width = currentLineWidth; listed = (count - 1) * 2; break;
+		case GL_LINE_LOOP: kind = KIND_LINES; width = currentLineWidth; listed = (count > 2 ? count : count - 1) * 2; break;
+		case GL_TRIANGLES: listed = count / 3 * 3; break;
+		case GL_QUADS: listed = count / 4 * 6; break;
+		default: listed = (count - 2) * 3; break; // strips, fans and convex polygons
+		}
+		if (listed <= 0) return;
+		size_t first = used;
+		ColorVertex *out = grow(listed);
+		const Matrix2f &m = matrices.back();
+		auto put = [&](int i) {
+			out->pos = transform ? m.apply(v[i].pos) : v[i].pos;
+			out->color = v[i].color;
+			out++;
+		};
+		switch (primitive) {
+		case GL_POINTS:
+		case GL_LINES:
+		case GL_TRIANGLES:
+			for (int i = 0; i < listed; i++)
+				put(i);
+			break;
+		case GL_LINE_STRIP:
+		case GL_LINE_LOOP:
+			for (int i = 0; i + 1 < count; i++) {
+				put(i);
+				put(i + 1);
+			}
+			if (primitive == GL_LINE_LOOP && count > 2) {
+				put(count - 1);
+				put(0);
+			}
+			break;
+		case GL_TRIANGLE_STRIP:
+			for (int i = 0; i + 2 < count; i++) {
+				put(i);
+				put(i + 1);
+				put(i + 2);
+			}
+			break;
+		case GL_QUADS:
+			for (int i = 0; i + 3 < count; i += 4) {
+				put(i);
+				put(i + 1);
+				put(i + 2);
+				put(i);
+				put(i + 2);
+				put(i + 3);
+			}
+			break;
+		default:
+			// only convex polygons are drawn by the scene, so a fan is enough
+			for (int i = 1; i + 1 < count; i++) {
+				put(0);
+				put(i);
+				put(i + 1);
+			}
+			break;
+		}
+		queue(kind, width, first);
+	}
+	// hands every run of commands with the same key to the backend as one draw
+	void flush() {
+		if (commands.empty()) return;
+		// first tells commands with the same key apart in the order they came in, so a plain sort is stable here
+		std::sort(commands.begin(), commands.end(), [](const Command &a, const Command &b) {
+			return a.key != b.key ? a.key < b.key : a.first < b.first;
+		});
+		float lineWidth = -1, pointSize = -1;
+		for (size_t i = 0; i < commands.size();) {
+			size_t j = i + 1;
+			while (j < commands.size() && commands[j].key == commands[i].key)
+				j++;
+			// a run that already lies in one piece is drawn from where it is, others are copied together first
+			const ColorVertex *first = &vertices[commands[i].first];
+			int count = commands[i].count;
+			bool together = true;
+			for (size_t k = i + 1; k < j; k++) {
+				together = together && commands[k].first == commands[k - 1].first + commands[k - 1].count;
+				count += commands[k].count;
+			}
+			if (!together) {
+				batch.clear();
+				for (size_t k = i; k < j; k++)
+					batch.insert(batch.end(), vertices.begin() + commands[k].first, vertices.begin() + commands[k].first + commands[k].count);
+				first = &batch[0];
+				count = (int)batch.size();
+			}
+			int kind = (int)(commands[i].key >> 32 & 3);
+			float width;
+			uint32_t widthBits = (uint32_t)commands[i].key;
+			memcpy(&width, &widthBits, sizeof(width));
+			if (kind == KIND_LINES && width != lineWidth)
+				backend->lineWidth(lineWidth = width);
+			if (kind == KIND_POINTS && width != pointSize)
+				backend->pointSize(pointSize = width);
+			int primitive = kind == KIND_TRIANGLES ? GL_TRIANGLES : kind == KIND_LINES ? GL_LINES : GL_POINTS;
+			backend->drawArrays(primitive, first, count);
+			i = j;
+		}
+		commands.clear();
+		used = 0;
+	}
+	void swapBuffers() {
+		flush();
+		backend->swapBuffers();
+	}
+};
+
+GLRenderer glRenderer;
+thread_local RenderQueue renderQueue;
+thread_local IRenderer *renderer = &glRenderer;
+
+// draws through the queue in front of the backend unless batching is turned off
+void useRenderer(IRenderer *backend) {
+	renderQueue.backend = backend;
+	renderer = BATCH_DRAWS ? (IRenderer *)&renderQueue : backend;
+}
+
+// the parts of a frame that are timed separately
+enum ProfilePhase {
+	PHASE_UPDATE_BEHAVIORS,
+	PHASE_BEFORE_REDISPLAY,
+	PHASE_COLLISION_BROADPHASE,
+	PHASE_COLLISION_NARROWPHASE,
+	PHASE_TREE_GENERATION,
+	PHASE_DRAW_TREES,
+	PHASE_DRAW_WAVES,
+	PHASE_DRAW_SHAPES,
+	PHASE_DRAW_PARTICLES,
+	PHASE_DRAW_OTHERS,
+	PHASE_DRAW_PLAYER,
+	PHASE_SUBMIT_BATCHES,
+	PHASE_SWAP_BUFFERS,
+	PHASE_COUNT
+};
+
+const char *PHASE_NAMES[PHASE_COUNT] = {
+	"Update behaviors",
+	"Before redisplay",
+	"Collision broadphase",
+	"Collision narrowphase",
+	"Tree generation",
+	"Draw trees",
+	"Draw waves",
+	"Draw shapes",
+	"Draw particles",
+	"Draw others",
+	"Draw player",
+	"Submit batches",
+	"Swap buffers"
+};
+
+// keeps the newest N items, one thread writes without ever waiting and any thread can copy out what was published
+template <typename T, int N>
+struct RingBuffer {
+	T items[N];
+	std::atomic<uint64_t> written{ 0 };
+	void push(const T &item) {
+		uint64_t index = written.load(std::memory_order_relaxed);
+		items[index % N] = item;
+		written.store(index + 1, std::memory_order_release);
+	}
+	// copies up to count of the newest items, oldest first. the writer may go on pushing meanwhile and
+	// overwrite the oldest slots being copied, so the ones it could have reached by the end are dropped
+	void copyNewest(size_t count, std::vector<T> &out) const {
+		uint64_t end = written.load(std::memory_order_acquire);
+		uint64_t begin = end > count ? end - count : 0;
+		if (end - begin > (uint64_t)N) begin = end - N;
+		out.clear();
+		for (uint64_t i = begin; i < end; i++)
+			out.push_back(items[i % N]);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// items up to written are done and the one at written may be half filled, each one replaced the item N before it
+		uint64_t reached = written.load(std::memory_order_relaxed) + 1;
+		uint64_t kept = reached > (uint64_t)N ? reached - N : 0;
+		if (kept > begin)
+			out.erase(out.begin(), out.begin() + (size_t)std::min(kept - begin, (uint64_t)out.size()));
+	}
+};
+
+// collects how long every phase of every frame took, times are in nanoseconds since the profiler was created
+struct Profiler {
+	struct Event {
+		int frame;
+		int phase;
+		int64_t start, duration;
+	};
+	struct FrameSample {
+		int frame;
+		int64_t start, duration;
+		int64_t phases[PHASE_COUNT]; // total time spent in each phase during the frame
+		int64_t vertices; // handed to the renderer during the frame
+		int64_t culled; // items outside the view
+		int64_t repainted; // pixels the software renderer drew again
+		int64_t stateChanges, drawCalls; // made on the renderer the scene draws with
+	};
+	RingBuffer<Event, 1 << 16> events;
+	RingBuffer<FrameSample, 1 << 12> frames;
+	time_point<steady_clock> origin = steady_clock::now();
+	FrameSample current;
+	uint64_t frameVertexStart = 0, frameCulledStart = 0, frameRepaintedStart = 0, frameStateStart = 0, frameDrawStart = 0;
+	int frame = 0;
+	bool inFrame = false;
+	bool enabled = true; // off while many worlds run at once, they would all record into the same frame
+	int64_t now() const {
+		return duration_cast<nanoseconds>(steady_clock::now() - origin).count();
+	}
+	void beginFrame() {
+		current = FrameSample();
+		current.frame = frame;
+		current.start = now();
+		frameVertexStart = verticesEmitted;
+		frameCulledStart = itemsCulled;
+		frameRepaintedStart = pixelsRepainted;
+		frameStateStart = stateChanges;
+		frameDrawStart = drawCalls;
+		inFrame = true;
+	}
+	void endFrame() {
+		if (!inFrame) return;
+		current.duration = now() - current.start;
+		current.vertices = (int64_t)(verticesEmitted - frameVertexStart);
+		current.culled = (int64_t)(itemsCulled - frameCulledStart);
+		current.repainted = (int64_t)(pixelsRepainted - frameRepaintedStart);
+		current.stateChanges = (int64_t)(stateChanges - frameStateStart);
+		current.drawCalls = (int64_t)(drawCalls - frameDrawStart);
+		frames.push(current);
+		frame++;
+		inFrame = false;
+	}
+	void record(int phase, int64_t start, int64_t end) {
+		if (!enabled) return;
+		Event event = { frame, phase, start, end - start };
+		events.push(event);
+		current.phases[phase] += end - start;
+	}
+	static double percentile(std::vector<int64_t> &values, double p) {
+		if (values.empty()) return 0;
+		std::sort(values.begin(), values.end());
+		size_t rank = (size_t)ceil(p / 100 * values.size());
+		return values[std::max(rank, (size_t)1) - 1] / 1e6; // in milliseconds
+	}
+	// prints p50/p95/p99 of the newest frames, and the p95 of every phase that took any time
+	// kept between reports so reporting does not allocate once they have grown
+	std::vector<FrameSample> samples;
+	std::vector<int64_t> values;
+	void report(size_t frameCount) {
+		frames.copyNewest(frameCount, samples);
+		if (samples.empty()) return;
+		values.clear();
+		for (size_t i = 0; i < samples.size(); i++)
+			values.push_back(samples[i].duration);
+		std::cout << "Frame time p50: " << percentile(values, 50) << " ms  p95: " << percentile(values, 95)
+			<< " ms  p99: " << percentile(values, 99) << " ms" << std::endl;
+		std::cout << "  p95 by phase:";
+		const char *separator = " ";
+		for (int phase = 0; phase < PHASE_COUNT; phase++) {
+			values.clear();
+			for (size_t i = 0; i < samples.size(); i++)
+				values.push_back(samples[i].phases[phase]);
+			double p95 = percentile(values, 95);
+			if (p95 > 0) {
+				std::cout << separator << PHASE_NAMES[phase] << " " << p95 << " ms";
+				separator = ", ";
+			}
+		}
+		std::cout << std::endl;
+		std::cout << "  Vertices per frame: " << average(samples, &FrameSample::vertices)
+			<< ", culled items: " << average(samples, &FrameSample::culled)
+			<< ", repainted pixels: " << average(samples, &FrameSample::repainted) << std::endl;
+		std::cout << "  State changes per frame: " << average(samples, &FrameSample::stateChanges)
+			<< ", draw calls: " << average(samples, &FrameSample::drawCalls) << std::endl;
+	}
+	static int64_t average(const std::vector<FrameSample> &samples, int64_t FrameSample::*field) {
+		if (samples.empty()) return 0;
+		int64_t total = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+			total += samples[i].*field;
+		return total / (int64_t)samples.size();
+	}
+	// writes the buffered frames and phases in the Chrome trace event format, open it in chrome://tracing
+	bool writeChromeTrace(const char *path) {
+		std::ofstream file(path);
+		if (!file) return false;
+		std::vector<FrameSample> samples;
+		std::vector<Event> phases;
+		frames.copyNewest(1 << 12, samples);
+		events.copyNewest(1 << 16, phases);
+		// microseconds with the nanoseconds after the point, the default 6 digits would round them past a second
+		file << std::fixed;
+		file.precision(3);
+		file << "{\"traceEvents\":[\n";
+		bool first = true;
+		for (size_t i = 0; i < samples.size(); i++) {
+			file << (first ? "" : ",\n") << "{\"name\":\"Frame " << samples[i].frame << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+				<< samples[i].start / 1e3 << ",\"dur\":" << samples[i].duration / 1e3 << "}";
+			first = false;
+		}
+		for (size_t i = 0; i < phases.size(); i++) {
+			file << (first ? "" : ",\n") << "{\"name\":\"" << PHASE_NAMES[phases[i].phase] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+				<< phases[i].start / 1e3 << ",\"dur\":" << phases[i].duration / 1e3 << ",\"args\":{\"frame\":" << phases[i].frame << "}}";
+			first = false;
+		}
+		file << "\n]}\n";
+		return (bool)file;
+	}
+};
+
+Profiler profiler;
+
+// times the enclosing block as one phase of the current frame
+struct ProfileScope {
+	int phase;
+	int64_t start;
+	ProfileScope(int phase) : phase(phase), start(profiler.now()) {
+	}
+	~ProfileScope() {
+		profiler.record(phase, start, profiler.now());
+	}
+};
+
 struct IDrawable {
+	virtual ~IDrawable() {
+	}
 	virtual void draw() = 0;
+	// which phase of the frame profile the drawing time is counted in
+	virtual int getProfilePhase() {
+		return PHASE_DRAW_OTHERS;
+	}
+	// the world box everything draw() touches fits in, false when unknown and it is always drawn
+	virtual bool getBounds(Bounds &bounds) {
+		return false;
+	}
 };
 
 struct IUpdateBehavior {
+	virtual ~IUpdateBehavior() {
+	}
 	virtual void update(float time, float timeDelta) = 0;
+	// behaviors that write state shared with others must say so, they run one after another
+	// once the independent behaviors, which run in parallel, are done
+	virtual bool isSerial() {
+		return false;
+	}
 };
 
 struct IMover {
+	virtual ~IMover() {
+	}
 	virtual void move(Vector2f position) = 0;
 	virtual Vector2f getPosition() = 0;
 };
@@ -49,10 +1550,14 @@ struct Point : public IDrawable, public IMover {
 	Vector2f pos;
 	float size = 10;
 	void draw() {
-		glPointSize(size);
-		glBegin(GL_POINTS);
-		glVertex2f(pos.x, pos.y);
-		glEnd();
+		renderer->pointSize(size);
+		renderer->begin(GL_POINTS);
+		renderer->vertex(pos.x, pos.y);
+		renderer->end();
+	}
+	bool getBounds(Bounds &bounds) {
+		bounds = { { pos.x - size / 2, pos.y - size / 2 }, { pos.x + size / 2, pos.y + size / 2 } };
+		return true;
 	}
 	void move(Vector2f position) {
 		pos = position;
@@ -62,27 +1567,108 @@ struct Point : public IDrawable, public IMover {
 	}
 };
 
+// a polyline shared by every mover that runs along it, cleaned up once when it is made and never changed after
+struct Path {
+	std::vector<Vector2f> points;
+	std::vector<float> arcLength; // distance along the path to each point, ends with the total length
+	bool closed = true; // the last point leads back to the first
+	size_t rawCount = 0; // how many samples it was made from
+
+	// drops repeated samples, then every point that is closer than tolerance to the line through
+	// its neighbours (Douglas-Peucker), a tolerance of 0 only drops the repeats
+	Path(const Vector2f *samples, size_t count, float tolerance, bool closed = true) : closed(closed), rawCount(count) {
+		std::vector<Vector2f> unique;
+		for (size_t i = 0; i < count; i++)
+			if (unique.empty() || sqrDistance(unique.back(), samples[i]) > 0)
+				unique.push_back(samples[i]);
+		while (closed && unique.size() > 1 && sqrDistance(unique.back(), unique[0]) == 0)
+			unique.pop_back();
+		if (unique.size() < 3 || tolerance <= 0)
+			points = unique;
+		else
+			simplify(unique, tolerance);
+		float total = 0;
+		for (size_t i = 0; i < points.size(); i++) {
+			arcLength.push_back(total);
+			if (i + 1 < points.size()) total += distance(points[i], points[i + 1]);
+		}
+		if (closed && points.size() > 1) {
+			total += distance(points.back(), points[0]);
+			arcLength.push_back(total);
+		}
+	}
+	void simplify(const std::vector<Vector2f> &in, float tolerance) {
+		std::vector<bool> keep(in.size(), false);
+		keep[0] = keep[in.size() - 1] = true;
+		// an explicit stack of ranges, a path with thousands of samples would recurse too deep
+		std::vector<std::pair<size_t, size_t>> ranges;
+		ranges.push_back(std::make_pair((size_t)0, in.size() - 1));
+		while (!ranges.empty()) {
+			size_t first = ranges.back().first, last = ranges.back().second;
+			ranges.pop_back();
+			Vector2f a = in[first], b = in[last];
+			float dx = b.x - a.x, dy = b.y - a.y;
+			float length = sqrt(dx * dx + dy * dy);
+			size_t farthest = first;
+			float farthestDistance = 0;
+			for (size_t i = first + 1; i < last; i++) {
+				float d = length > 0 ? fabsf(dy * (in[i].x - a.x) - dx * (in[i].y - a.y)) / length : distance(in[i], a);
+				if (d > farthestDistance) {
+					farthestDistance = d;
+					farthest = i;
+				}
+			}
+			if (farthestDistance > tolerance) {
+				keep[farthest] = true;
+				ranges.push_back(std::make_pair(first, farthest));
+				ranges.push_back(std::make_pair(farthest, last));
+			}
+		}
+		for (size_t i = 0; i < in.size(); i++)
+			if (keep[i]) points.push_back(in[i]);
+	}
+	float length() const {
+		return arcLength.empty() ? 0 : arcLength.back();
+	}
+	// the point at a distance along the path, wraps around on a closed path and stops at the ends of an open one
+	Vector2f at(float d) const {
+		if (points.size() < 2) return points.empty() ? Vector2f{ 0, 0 } : points[0];
+		float total = length();
+		if (closed) {
+			d = fmodf(d, total);
+			if (d < 0) d += total;
+		}
+		else
+			d = std::min(std::max(d, 0.0f), total);
+		size_t i = std::upper_bound(arcLength.begin(), arcLength.end(), d) - arcLength.begin();
+		i = std::min(std::max(i, (size_t)1), arcLength.size() - 1) - 1;
+		Vector2f a = points[i], b = points[(i + 1) % points.size()];
+		float segment = arcLength[i + 1] - arcLength[i];
+		float t = segment > 0 ? (d - arcLength[i]) / segment : 0;
+		return{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+	}
+};
+
+// moves along a shared path at a constant speed, only where it is on the path is its own
 struct PathFollowingBehavior : IUpdateBehavior {
-	std::vector<Vector2f> positions;
+	const Path *path;
 	IMover *mover;
-	float moveDelay = 0; // in seconds
+	float offset = 0; // distance along the path
+	float speed = 0; // per second
 	bool running = false;
 	bool reverse = false;
-	int idx = 0;
-	int nextIndex() {
-		if (reverse)
-			return (--idx += positions.size()) %= positions.size();
-		else
-			return ++idx %= positions.size();
-	}
-	float elapsedTime = 0;
 	void update(float time, float timeDelta) {
 		if (!running) return;
-		if (elapsedTime > moveDelay) {
-			mover->move(positions[nextIndex()]);
-			elapsedTime -= moveDelay;
+		offset += (reverse ? -speed : speed) * timeDelta;
+		float length = path->length();
+		if (length > 0) {
+			offset = fmodf(offset, length);
+			if (offset < 0) offset += length;
 		}
-		elapsedTime += timeDelta;
+		mover->move(path->at(offset));
+	}
+	bool isSerial() {
+		return true; // the mover of a store entity moves it in the store's grid, which every follower shares
 	}
 	void toggleRunningState() {
 		running = !running;
@@ -92,6 +1678,27 @@ struct PathFollowingBehavior : IUpdateBehavior {
 	}
 };
 
+// level of detail: curves are cut into as few straight pieces as keep them within LOD_PIXEL_ERROR of
+// the real curve on screen, and tree levels whose branches would be shorter than LOD_BRANCH_PIXELS are
+// left out. LOD_QUALITY divides both, 2 halves the allowed error. the view is never zoomed, so a world
+// unit is one pixel
+float LOD_QUALITY = 1;
+const float LOD_PIXEL_ERROR = 0.5f;
+const float LOD_BRANCH_PIXELS = 1;
+const int LOD_MAX_SEGMENTS = 1024;
+
+float lodPixelError() {
+	return LOD_PIXEL_ERROR / LOD_QUALITY;
+}
+
+// segments for a circle of the given radius on screen, so the middle of every chord stays within the error
+int lodCircleSegments(float radiusPixels) {
+	float error = lodPixelError();
+	if (radiusPixels <= error) return 3;
+	int segments = (int)ceil(PI / acos(1.0 - error / radiusPixels));
+	return std::min(std::max(segments, 3), LOD_MAX_SEGMENTS);
+}
+
 struct SineWave : public IDrawable {
 	Vector2f pos;
 	float length = 100;
@@ -99,20 +1706,55 @@ struct SineWave : public IDrawable {
 	float frequency = 1;
 	float shift = 0;
 	Vector3f color = { 141 / 255.0f, 14 / 255.0f, 200 / 255.0f };
-	void draw() {
-		glPushMatrix();
-		glTranslatef(pos.x, pos.y, 0);
-		glTranslatef(-length / 2, 0, 0);
-		glColor3f(color.x, color.y, color.z);
-		glBegin(GL_LINE_STRIP);
-		int rounds = round(length) * frequency * amplitude / 10; // made up number
+	// amplitude * sin and amplitude * cos of frequency * x at every sample, only the shift changes per frame
+	std::vector<float> sinTable;
+	std::vector<float> cosTable;
+	float builtLength = -1, builtAmplitude, builtFrequency, builtQuality;
+	void buildTables() {
+		builtLength = length;
+		builtAmplitude = amplitude;
+		builtFrequency = frequency;
+		builtQuality = LOD_QUALITY;
+		sinTable.clear();
+		cosTable.clear();
+		// a chord of length h across a curve of curvature k strays about k h^2 / 8 from it,
+		// and a sine bends the most at its peaks where the curvature is amplitude * frequency^2
+		float curvature = fabsf(amplitude) * frequency * frequency;
+		float step = curvature > 0 ? sqrt(8 * lodPixelError() / curvature) : length;
+		int rounds = std::min((int)ceil(length / std::max(step, 0.25f)), LOD_MAX_SEGMENTS * 16);
+		if (rounds <= 0) return;
 		float factor = length / rounds;
 		for (int i = 0; i <= rounds; i++) {
 			float x = i * factor;
-			glVertex2f(x, amplitude * sinf(frequency * (x + shift)));
+			sinTable.push_back(amplitude * sinf(frequency * x));
+			cosTable.push_back(amplitude * cosf(frequency * x));
 		}
-		glEnd();
-		glPopMatrix();
+	}
+	int getProfilePhase() {
+		return PHASE_DRAW_WAVES;
+	}
+	bool getBounds(Bounds &bounds) {
+		float a = fabsf(amplitude);
+		bounds = { { pos.x - length / 2, pos.y - a }, { pos.x + length / 2, pos.y + a } };
+		return true;
+	}
+	void draw() {
+		if (builtLength != length || builtAmplitude != amplitude || builtFrequency != frequency || builtQuality != LOD_QUALITY)
+			buildTables();
+		if (sinTable.empty()) return;
+		// sin(a + b) = sin(a) cos(b) + cos(a) sin(b), so shifting costs one sin and one cos per wave
+		float phase = frequency * shift;
+		float cosPhase = cosf(phase), sinPhase = sinf(phase);
+		float factor = length / (sinTable.size() - 1);
+		renderer->pushMatrix();
+		renderer->translate(pos.x, pos.y);
+		renderer->translate(-length / 2, 0);
+		renderer->color(color.x, color.y, color.z);
+		renderer->begin(GL_LINE_STRIP);
+		for (size_t i = 0; i < sinTable.size(); i++)
+			renderer->vertex(i * factor, sinTable[i] * cosPhase + cosTable[i] * sinPhase);
+		renderer->end();
+		renderer->popMatrix();
 	}
 };
 
@@ -128,6 +1770,8 @@ struct SineWaveBehavior : public IUpdateBehavior {
 	}
 };
 
+const Vector3f BACKGROUND_COLOR = { 14 / 255.0f, 167 / 255.0f, 200 / 255.0f }; // what display clears to
+
 std::vector<Vector3f> availableColors = {
 	{ 255 / 255.0f, 87 / 255.0f, 51 / 255.0f },
 	{ 255 / 255.0f, 189 / 255.0f, 51 / 255.0f },
@@ -137,10 +1781,16 @@ std::vector<Vector3f> availableColors = {
 	{ 141 / 255.0f, 14 / 255.0f, 200 / 255.0f }
 };
 
+// rand for the world being built or played, see World
+int worldRandom();
+
 Vector3f getRandomColor() {
-	return availableColors[rand() % availableColors.size()];
+	return availableColors[worldRandom() % availableColors.size()];
 }
 
+// the deepest a tree grows, its buffer holds 6 (2^depth - 1) vertices, 8 MB at this depth
+const int TREE_MAX_DEPTH = 16;
+
 struct Tree : public IDrawable {
 	Vector2f pos;
 	int depth = 7;
@@ -151,58 +1801,170 @@ struct Tree : public IDrawable {
 	float width = 10.0f;
 	float randomRange = 0.3; // should be between 0 and 1
 	int state; // set to random value for different state on each tree
+	// every branch of the tree as a thick line (two triangles), in tree space, level by level from the trunk up
+	std::vector<ColorVertex> vertices;
+	std::vector<Bounds> levelBounds; // around the vertices of the first n + 1 levels, in tree space
+	float depthFade = 1; // how far the deepest level has faded in, depth dancing moves it along with the depth
+	std::vector<ColorVertex> fadedVertices; // the deepest level blended toward the background
 	Tree() {
-		state = rand();
+		state = worldRandom();
+	}
+	int getProfilePhase() {
+		return PHASE_DRAW_TREES;
+	}
+	// only known once the geometry is built, display builds every dirty tree before drawing
+	bool getBounds(Bounds &bounds) {
+		if (isGeometryDirty() || drawnLevels() == 0) return false;
+		bounds = levelBounds[drawnLevels() - 1].transformed(pos, startAngle);
+		return true;
+	}
+	// the first n levels are the first 2^n - 1 branches, so a shallower tree is a prefix of the buffer
+	int drawnLevels() {
+		return std::min(lodLevels(), levels);
 	}
 	void draw() {
-		glPushMatrix();
-		glTranslatef(pos.x, pos.y, 0);
-		glRotatef(startAngle, 0, 0, 1);
-		int r = rand();
-		makeTree(length, depth, width, state);
-		glPopMatrix();
-		srand(r);
+		if (isGeometryDirty())
+			rebuildGeometry();
+		int drawn = drawnLevels();
+		if (drawn == 0) return;
+		// the level depth dancing just added fades in, unless the level of detail cut the tree below it
+		bool fading = drawn == depth && depthFade < 1;
+		int solid = fading ? drawn - 1 : drawn;
+		renderer->pushMatrix();
+		renderer->translate(pos.x, pos.y);
+		renderer->rotate(startAngle);
+		if (solid > 0)
+			renderer->drawArrays(GL_TRIANGLES, &vertices[0], ((1 << solid) - 1) * 6);
+		if (fading) {
+			const ColorVertex *level = &vertices[((1 << solid) - 1) * 6];
+			fadedVertices.resize((1 << solid) * 6);
+			for (size_t i = 0; i < fadedVertices.size(); i++) {
+				const Vector3f &c = level[i].color;
+				fadedVertices[i].pos = level[i].pos;
+				fadedVertices[i].color = { BACKGROUND_COLOR.x + (c.x - BACKGROUND_COLOR.x) * depthFade,
+					BACKGROUND_COLOR.y + (c.y - BACKGROUND_COLOR.y) * depthFade, BACKGROUND_COLOR.z + (c.z - BACKGROUND_COLOR.z) * depthFade };
+			}
+			renderer->drawArrays(GL_TRIANGLES, &fadedVertices[0], (int)fadedVertices.size());
+		}
+		renderer->popMatrix();
 	}
-	void setNextColor(int state) {
-		Vector3f currentColor = availableColors[state % availableColors.size()];
-		glColor3f(currentColor.x, currentColor.y, currentColor.z);
+	Vector3f getNextColor(int state) {
+		return availableColors[state % availableColors.size()];
 	}
 	// returns a float value between (1-ranRange) and (1+ranRange) inclusively
-	float randomness(int state) {
-		return (1.0 - randomRange) + randomRange * 2 * (state % 101 / 100.0f);
+	float randomness(int random) {
+		return (1.0 - randomRange) + randomRange * 2 * (random % 101 / 100.0f);
 	}
-	int printed = 0;
-	void makeTree(float length, int depth, float currentWidth, int state) {
-		if (depth <= 0) return;
-		srand(state);
-		glPushMatrix();
-		glLineWidth(currentWidth);
-		// draw the trunk
-		glBegin(GL_LINES);
-		setNextColor(rand());
-		glVertex2f(0, 0);
-		setNextColor(rand());
-		glVertex2f(0, length);
-		glEnd();
-		// then recursively draw the left and right tree
-		glTranslatef(0, length, 0);
-
-		int s1 = rand(), s2 = rand();
-		float r1 = randomness(s1), r2 = randomness(s2);
-		float r3 = randomness(s1), r4 = randomness(s2);
-
-		glPushMatrix();
-		glRotatef(splitAngle * r3, 0, 0, 1);
-		makeTree(length * splitSizeFactor * r1, depth - 1, currentWidth * splitSizeFactor * r1, s1);
-		glPopMatrix();
-
-		glPushMatrix();
-		glRotatef(-splitAngle * r4, 0, 0, 1);
-		makeTree(length * splitSizeFactor * r2, depth - 1, currentWidth * splitSizeFactor * r2, s2);
-		glPopMatrix();
+	// the parameters the cached vertices were generated with. depth and the level of detail only decide
+	// how many levels are drawn, so changing them never regenerates what is there
+	struct BuildParameters {
+		float length = -1; // never a real length, so the first draw builds
+		float splitAngle, splitSizeFactor, width, randomRange;
+		int state;
+	} built;
+	int levels = 0; // how many levels of branches the vertices hold
+	bool parametersChanged() {
+		return built.length != length || built.splitAngle != splitAngle || built.splitSizeFactor != splitSizeFactor ||
+			built.width != width || built.randomRange != randomRange || built.state != state;
+	}
+	bool isGeometryDirty() {
+		return parametersChanged() || lodLevels() > levels;
+	}
+	// levels until even the longest branch a level can have gets shorter than LOD_BRANCH_PIXELS
+	int lodLevels() {
+		float threshold = LOD_BRANCH_PIXELS / LOD_QUALITY;
+		float longest = length, growth = splitSizeFactor * (1 + randomRange);
+		int count = 0;
+		while (count < depth && longest >= threshold) {
+			count++;
+			longest *= growth;
+		}
+		return count;
+	}
+	// where a branch starts and how it grows, enough to generate the whole subtree above it
+	struct Branch {
+		Vector2f base;
+		float angle; // in degrees counter-clockwise from straight up
+		float length, width;
+		uint32_t path; // 1 for the trunk, the children of branch p are 2p and 2p + 1
+	};
+	// the branches of the next level, generated but not written yet. kept between rebuilds so they do not allocate
+	std::vector<Branch> frontier, nextFrontier;
+	// branches are stored breadth first, in the order of their paths, so branch p owns the six vertices from
+	// 6 (p - 1) on. a new level only appends, and regenerating from the trunk is left to the parameters changing
+	void rebuildGeometry() {
+		if (parametersChanged()) {
+			built.length = length;
+			built.splitAngle = splitAngle;
+			built.splitSizeFactor = splitSizeFactor;
+			built.width = width;
+			built.randomRange = randomRange;
+			built.state = state;
+			levels = 0;
+			Branch trunk = { { 0, 0 }, 0, length, width, 1 };
+			frontier.assign(1, trunk);
+		}
+		int wanted = lodLevels();
+		if (levels >= wanted) return;
+		vertices.resize(((1 << wanted) - 1) * 6);
+		levelBounds.resize(wanted);
+		for (; levels < wanted; levels++) {
+			// every branch of a level is independent of the others, so big levels are split between the threads
+			int count = (int)frontier.size();
+			nextFrontier.resize(count * 2);
+			jobs.parallelFor(count, 256, [this](int begin, int end) {
+				for (int i = begin; i < end; i++)
+					makeBranch(frontier[i], nextFrontier[i * 2], nextFrontier[i * 2 + 1]);
+			});
+			frontier.swap(nextFrontier);
+			Bounds bounds = levels > 0 ? levelBounds[levels - 1] : Bounds{ vertices[0].pos, vertices[0].pos };
+			for (int i = (count - 1) * 6; i < (count * 2 - 1) * 6; i++) {
+				bounds.min.x = std::min(bounds.min.x, vertices[i].pos.x);
+				bounds.min.y = std::min(bounds.min.y, vertices[i].pos.y);
+				bounds.max.x = std::max(bounds.max.x, vertices[i].pos.x);
+				bounds.max.y = std::max(bounds.max.y, vertices[i].pos.y);
+			}
+			levelBounds[levels] = bounds;
+		}
+	}
+	// every random choice about a branch comes from the tree's state and where the branch is in the tree
+	enum { BASE_COLOR, TIP_COLOR, GROWTH };
+	int branchRandom(uint32_t path, int purpose) {
+		return hashRandom(state, (uint64_t)path * 4 + purpose);
+	}
+	// writes the two triangles of a branch, from base to tip with the given width
+	void writeBranch(ColorVertex *out, Vector2f base, Vector2f tip, float angle, float width, Vector3f baseColor, Vector3f tipColor) {
+		// thinner than a pixel would disappear, glLineWidth never went below 1 either
+		float halfWidth = (width < 1 ? 1 : width) / 2;
+		float rad = angle * PI / 180;
+		Vector2f side = { cosf(rad) * halfWidth, sinf(rad) * halfWidth };
+		ColorVertex b0 = { { base.x - side.x, base.y - side.y }, baseColor };
+		ColorVertex b1 = { { base.x + side.x, base.y + side.y }, baseColor };
+		ColorVertex t0 = { { tip.x - side.x, tip.y - side.y }, tipColor };
+		ColorVertex t1 = { { tip.x + side.x, tip.y + side.y }, tipColor };
+		out[0] = b0;
+		out[1] = b1;
+		out[2] = t1;
+		out[3] = b0;
+		out[4] = t1;
+		out[5] = t0;
+	}
+	// writes the branch itself and works out the two branches that split from its tip
+	void makeBranch(const Branch &branch, Branch &left, Branch &right) {
+		float rad = branch.angle * PI / 180;
+		Vector2f tip = { branch.base.x - sinf(rad) * branch.length, branch.base.y + cosf(rad) * branch.length };
+		Vector3f baseColor = getNextColor(branchRandom(branch.path, BASE_COLOR));
+		Vector3f tipColor = getNextColor(branchRandom(branch.path, TIP_COLOR));
+		writeBranch(&vertices[(branch.path - 1) * 6], branch.base, tip, branch.angle, branch.width, baseColor, tipColor);
 
-		setDefaultLineWidth();
-		glPopMatrix();
+		// a child bends and shrinks by the same random factor
+		uint32_t leftPath = branch.path * 2, rightPath = branch.path * 2 + 1;
+		float r1 = randomness(branchRandom(leftPath, GROWTH));
+		float r2 = randomness(branchRandom(rightPath, GROWTH));
+		left = { tip, branch.angle + splitAngle * r1, branch.length * splitSizeFactor * r1,
+			branch.width * splitSizeFactor * r1, leftPath };
+		right = { tip, branch.angle - splitAngle * r2, branch.length * splitSizeFactor * r2,
+			branch.width * splitSizeFactor * r2, rightPath };
 	}
 };
 
@@ -231,8 +1993,19 @@ struct TreeBehavior : public IUpdateBehavior {
 	void update(float time, float timeDelta) {
 		if (splitAngleDancing)
 			tree->splitAngle = splitAngle + splitAngleDance * sin(splitAngleDanceFreq * time);
-		if (depthDancing)
-			tree->depth = depth + (int)roundf(depthDance * sin(depthDanceFreq * time));
+		if (depthDancing) {
+			float dance = depthDance * sin(depthDanceFreq * time);
+			int levels = (int)roundf(dance);
+			tree->depth = std::min(std::max(depth + levels, 0), TREE_MAX_DEPTH);
+			// a level appears half a level before it is reached and is fully there when the next one appears.
+			// past the depth limit no level comes or goes, so nothing fades
+			if (tree->depth != depth + levels)
+				tree->depthFade = 1;
+			else
+				tree->depthFade = std::min(std::max(dance - levels + 0.5f, 0.0f), 1.0f);
+		}
+		else
+			tree->depthFade = 1;
 		if (lengthDancing)
 			tree->length = length + lengthDance * sin(lengthDanceFreq * time);
 		tree->randomRange = randomness ? randomRange : 0;
@@ -251,74 +2024,72 @@ struct TreeBehavior : public IUpdateBehavior {
 	}
 };
 
-time_point<system_clock> START_TIME;
-time_point<system_clock> PREVIOUS_TIME;
-time_point<system_clock> CURRENT_TIME;
-duration<double> TIME; // time duration since the program is loaded
-duration<double> TIME_DELTA;
+time_point<steady_clock> START_TIME;
+time_point<steady_clock> PREVIOUS_TIME;
+time_point<steady_clock> CURRENT_TIME;
+time_point<steady_clock> NEXT_FRAME_TIME;
+const duration<double> FIXED_TIME_STEP(1 / 60.0); // the simulation always advances by exactly this much
+const duration<double> MAX_FRAME_TIME(0.25); // longer stalls are not caught up, the game slows down instead
+double FRAME_RATE_CAP = 60; // frames drawn per second, 0 draws as often as possible
 int W = 800;
 int H = 600;
 float PLAYER_ACCELERATION = 5000.0f;
-float PLAYER_DRAG = 0.01f;
+float PLAYER_DRAG = 0.01f; // every world starts with this drag and gravity, a sweep can give it others
 float GRAVITY = 1000;
+float PLAYER_RADIUS = 25;
+float PLAYER_RESTITUTION = 0.5f; // how much of the speed into a shape bounces back
+size_t PARTICLE_LIMIT = 200000;
 
-std::vector<IUpdateBehavior*> updateBehaviors;
-std::vector<IDrawable*> drawables;
-std::vector<Vector2f> points;
-Vector2f playerPosition = { -326, -263 };
-Vector2f playerVelocity;
-Vector2f playerAcceleration = { 0, -GRAVITY };
-float playerAngle = 0;
-std::vector<TreeBehavior*> mainTree;
-std::vector<SineWaveBehavior*> mainWave;
 float sinAmplitude = 3.0;
 float sinFrequency = 10 * PI;
-std::vector<PathFollowingBehavior*> following;
 
 struct TrackingLine : public IDrawable, public IUpdateBehavior {
 	Vector2f pos1, pos2;
 	bool tracking = false;
 	float pullForce = 0.0001f;
+	// the player of the world it was spawned in, and the movers it ties the player to
+	Vector2f *playerPosition = NULL, *playerVelocity = NULL;
+	const std::vector<PathFollowingBehavior*> *following = NULL;
 	virtual void draw() override
 	{
 		if (!tracking) return;
-		glLineWidth(1000 / length());
-		glColor3f(0, 0.5, 0.5);
-		glBegin(GL_LINES);
-		glVertex2f(pos1.x, pos1.y);
-		glVertex2f(pos2.x, pos2.y);
-		glEnd();
+		renderer->lineWidth(1000 / length());
+		renderer->color(0, 0.5, 0.5);
+		renderer->begin(GL_LINES);
+		renderer->vertex(pos1.x, pos1.y);
+		renderer->vertex(pos2.x, pos2.y);
+		renderer->end();
+	}
+	virtual bool isSerial() override
+	{
+		return true; // writes playerVelocity and reads the mover position
 	}
 	virtual void update(float time, float timeDelta) override
 	{
-		pos1 = playerPosition;
-		pos2 = following[0]->mover->getPosition();
+		if (following->empty()) return;
+		pos1 = *playerPosition;
+		pos2 = (*following)[0]->mover->getPosition();
 		// applying force to the player
 		if (!tracking) return;
 		Vector2f difference = { pos2.x - pos1.x, pos2.y - pos1.y };
 		float magnitude = sqrDistance(pos1, pos2);
-		playerVelocity.x += difference.x * timeDelta * magnitude * pullForce;
-		playerVelocity.y += difference.y * timeDelta * magnitude * pullForce;
+		playerVelocity->x += difference.x * timeDelta * magnitude * pullForce;
+		playerVelocity->y += difference.y * timeDelta * magnitude * pullForce;
 	}
 	float length() {
 		return distance(pos1, pos2);
 	}
 };
-TrackingLine *trackingLine;
-
-double time() {
-	return TIME.count(); // returns time since game loaded in seconds
-}
-
-double timeDelta() { // time between last frame and current frame
-	return TIME_DELTA.count();
-}
+// the clock of the current world, defined with World
+double time();
+double timeDelta();
+float renderAlpha();
 
 void setDefaultColor() {
-	glColor3f(0, 0, 0);
+	renderer->color(0, 0, 0);
 }
 void setDefaultLineWidth() {
-	glLineWidth(1);
+	renderer->lineWidth(1);
 }
 
 float sineShiftFunc(float theta) {
@@ -329,463 +2100,3193 @@ float analogSineShiftFunc(float theta) {
 	return sinAmplitude*roundf(sin(2 * PI*theta));
 }
 
+// a function sampled at the vertex angles of a circle, for every segment count up to LOD_MAX_SEGMENTS. all
+// the counts share one block allocated at startup and each is filled the first time it is drawn; --batch draws
+// several worlds at once, so the first thread to need a count fills it while the others wait until it is ready
+struct SegmentTable {
+	enum { EMPTY, FILLING, READY };
+	float(*func)(float theta);
+	std::unique_ptr<float[]> values; // the count n starts at n * (n - 1) / 2
+	std::unique_ptr<std::atomic<int>[]> states;
+
+	SegmentTable(float(*func)(float theta)) : func(func),
+		values(new float[(size_t)(LOD_MAX_SEGMENTS + 1) * LOD_MAX_SEGMENTS / 2]),
+		states(new std::atomic<int>[LOD_MAX_SEGMENTS + 1]) {
+		for (int i = 0; i <= LOD_MAX_SEGMENTS; i++)
+			states[i].store(EMPTY, std::memory_order_relaxed);
+	}
+
+	// NULL past LOD_MAX_SEGMENTS, the caller then evaluates func itself
+	const float *get(int rounds) {
+		if (rounds > LOD_MAX_SEGMENTS) return NULL;
+		float *row = &values[(size_t)rounds * (rounds - 1) / 2];
+		std::atomic<int> &state = states[rounds];
+		if (state.load(std::memory_order_acquire) == READY) return row;
+		int expected = EMPTY;
+		if (state.compare_exchange_strong(expected, FILLING, std::memory_order_acquire)) {
+			float factor = 2 * PI / rounds;
+			for (int i = 0; i < rounds; i++)
+				row[i] = func(i * factor);
+			state.store(READY, std::memory_order_release);
+		}
+		else {
+			while (state.load(std::memory_order_acquire) != READY)
+				std::this_thread::yield();
+		}
+		return row;
+	}
+};
+
+float unitCos(float theta) { return cosf(theta); }
+float unitSin(float theta) { return sinf(theta); }
+
+SegmentTable unitCosines(unitCos);
+SegmentTable unitSines(unitSin);
+// the shift functions only depend on the vertex angle, so each one is evaluated once per segment count
+SegmentTable sineShifts(sineShiftFunc);
+SegmentTable analogSineShifts(analogSineShiftFunc);
+
+// NULL when shiftFunc has no table or rounds is past LOD_MAX_SEGMENTS
+const float *getShiftProfile(float(*shiftFunc)(float theta), int rounds) {
+	if (shiftFunc == sineShiftFunc) return sineShifts.get(rounds);
+	if (shiftFunc == analogSineShiftFunc) return analogSineShifts.get(rounds);
+	return NULL;
+}
+
 // can also draw ellipse too
-void drawCircle(int glPrimitive, Vector2f radius, float(*shiftFunc)(float theta) = NULL, int totalRounds = 0) {
-	int rounds = totalRounds ? totalRounds : radius.x + radius.y; // how precise the circle is, this number is made up
-	float factor = 2 * PI / rounds;
+// totalRounds fixes the number of segments, otherwise the level of detail picks it from how big the
+// circle is on screen, pixelScale being how much the current transform scales it
+void drawCircle(int glPrimitive, Vector2f radius, float(*shiftFunc)(float theta) = NULL, int totalRounds = 0, float pixelScale = 1) {
+	int rounds = totalRounds;
+	if (!rounds) {
+		// the wobble of a shift function was always sampled at radius.x + radius.y vertices, fewer
+		// would change its pattern, so keep that count for as long as the wobble can be seen
+		if (shiftFunc && fabsf(sinAmplitude) * pixelScale > lodPixelError())
+			rounds = radius.x + radius.y;
+		else
+			rounds = lodCircleSegments(std::max(radius.x, radius.y) * pixelScale);
+	}
+	if (rounds <= 0) return;
+	const float *cosines = unitCosines.get(rounds);
+	const float *sines = unitSines.get(rounds);
+	const float *shift = shiftFunc ? getShiftProfile(shiftFunc, rounds) : NULL;
+
+	renderer->begin(glPrimitive);
+	if (!cosines || (shiftFunc && !shift)) {
+		// too many segments for the tables, or a shift function without one
+		float factor = 2 * PI / rounds;
+		for (int i = 0; i < rounds; i++) {
+			float theta = i * factor;
+			float offset = shiftFunc ? shiftFunc(theta) : 0;
+			renderer->vertex((radius.x + offset) * cosf(theta), (radius.y + offset) * sinf(theta));
+		}
+	}
+	else if (shiftFunc) {
+		for (int i = 0; i < rounds; i++)
+			renderer->vertex((radius.x + shift[i]) * cosines[i], (radius.y + shift[i]) * sines[i]);
+	}
+	else {
+		for (int i = 0; i < rounds; i++)
+			renderer->vertex(radius.x * cosines[i], radius.y * sines[i]);
+	}
+	renderer->end();
+}
+
+// how a circle looks, where it is and how it spins lives in a ShapeStore
+struct Circle {
+	Vector2f radius;
+	float(*shiftFunc)(float theta) = NULL;
+	Vector3f color;
+	int rounds = 0;
+};
+
+// how a triangle looks, where it is and how it spins lives in a ShapeStore
+struct Triangle {
+	Vector2f points[3];
+	Vector3f color[3];
+	Vector2f center;
+	bool middle; // determine whether you want the triangle's pivot point to be in the middle
+};
+
+void drawShape(const Circle &circle, Vector2f pos, float angle, float scale) {
+	renderer->pushMatrix();
+	renderer->translate(pos.x, pos.y);
+	renderer->rotate(angle);
+	renderer->scale(scale, scale);
+	renderer->color(circle.color.x, circle.color.y, circle.color.z);
+	drawCircle(GL_LINE_LOOP, circle.radius, circle.shiftFunc, circle.rounds, fabsf(scale));
+	renderer->popMatrix();
+}
+
+void drawShape(const Triangle &triangle, Vector2f pos, float angle, float scale) {
+	renderer->pushMatrix();
+	renderer->translate(pos.x, pos.y);
+	renderer->rotate(angle);
+	renderer->scale(scale, scale);
+	if (triangle.middle)
+		renderer->translate(-triangle.center.x, -triangle.center.y);
+	renderer->begin(GL_TRIANGLES);
+	for (int i = 0; i < 3; i++) {
+		renderer->color(triangle.color[i].x, triangle.color[i].y, triangle.color[i].z);
+		renderer->vertex(triangle.points[i].x, triangle.points[i].y);
+	}
+	renderer->end();
+	renderer->popMatrix();
+}
+
+// radius of a circle around the shape's position that holds the whole shape at scale 1, whatever the angle
+float boundingRadius(const Circle &circle) {
+	float shift = circle.shiftFunc ? fabsf(sinAmplitude) : 0;
+	return std::max(circle.radius.x, circle.radius.y) + shift;
+}
+
+float boundingRadius(const Triangle &triangle) {
+	Vector2f pivot = triangle.middle ? triangle.center : Vector2f{ 0, 0 };
+	float radius = 0;
+	for (int i = 0; i < 3; i++)
+		radius = std::max(radius, distance(triangle.points[i], pivot));
+	return radius;
+}
+
+// sin(x) without calling into the C library: reduce to [-pi/2, pi/2] and evaluate an odd polynomial,
+// it stays within 6 float epsilons of sinf for every float argument below 3e4 in size. the vector
+// versions do the same multiplies and adds in the same order, without fusing any, so they match it bit for bit
+inline float fastSin(float x) {
+	float k = floorf(x * 0.159154943f + 0.5f); // nearest multiple of 2 pi
+	float r = x - k * 6.28125f - k * 0.00193530717f; // 2 pi split in two so k * 2 pi stays exact
+	if (r > 1.57079633f) r = 3.14159265f - r;
+	else if (r < -1.57079633f) r = -3.14159265f - r;
+	float r2 = r * r;
+	return r + r * r2 * (-1.66666667e-1f + r2 * (8.33333333e-3f + r2 * (-1.98412698e-4f + r2 * (2.75573192e-6f + r2 * -2.50521084e-8f))));
+}
+
+#if defined(SIMD_AVX2)
+inline __m256 fastSin8(__m256 x) {
+	__m256 k = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.159154943f)), _mm256_set1_ps(0.5f)));
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(6.28125f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(0.00193530717f)));
+	// mirror around +-pi/2 without branching
+	__m256 signBit = _mm256_and_ps(r, _mm256_set1_ps(-0.0f));
+	__m256 mirrored = _mm256_sub_ps(_mm256_or_ps(_mm256_set1_ps(3.14159265f), signBit), r);
+	__m256 outside = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), r), _mm256_set1_ps(1.57079633f), _CMP_GT_OQ);
+	r = _mm256_blendv_ps(r, mirrored, outside);
+	__m256 r2 = _mm256_mul_ps(r, r);
+	__m256 p = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(-2.50521084e-8f)), _mm256_set1_ps(2.75573192e-6f));
+	p = _mm256_add_ps(_mm256_mul_ps(r2, p), _mm256_set1_ps(-1.98412698e-4f));
+	p = _mm256_add_ps(_mm256_mul_ps(r2, p), _mm256_set1_ps(8.33333333e-3f));
+	p = _mm256_add_ps(_mm256_mul_ps(r2, p), _mm256_set1_ps(-1.66666667e-1f));
+	return _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r, r2), p), r);
+}
+#elif defined(SIMD_SSE2)
+inline __m128 fastSin4(__m128 x) {
+	// SSE2 has no floor, so round to the nearest integer and step down where that went up
+	__m128 y = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.159154943f)), _mm_set1_ps(0.5f));
+	__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(y));
+	k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpgt_ps(k, y), _mm_set1_ps(1.0f)));
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(6.28125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(0.00193530717f)));
+	// mirror around +-pi/2 without branching
+	__m128 signBit = _mm_and_ps(r, _mm_set1_ps(-0.0f));
+	__m128 mirrored = _mm_sub_ps(_mm_or_ps(_mm_set1_ps(3.14159265f), signBit), r);
+	__m128 outside = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), r), _mm_set1_ps(1.57079633f));
+	r = _mm_or_ps(_mm_and_ps(outside, mirrored), _mm_andnot_ps(outside, r));
+	__m128 r2 = _mm_mul_ps(r, r);
+	__m128 p = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(-2.50521084e-8f)), _mm_set1_ps(2.75573192e-6f));
+	p = _mm_add_ps(_mm_mul_ps(r2, p), _mm_set1_ps(-1.98412698e-4f));
+	p = _mm_add_ps(_mm_mul_ps(r2, p), _mm_set1_ps(8.33333333e-3f));
+	p = _mm_add_ps(_mm_mul_ps(r2, p), _mm_set1_ps(-1.66666667e-1f));
+	return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r, r2), p), r);
+}
+#endif
+
+// angle += rotateSpeed * timeDelta, what RotateBehavior did for one shape
+void rotateBatch(float *angle, const float *rotateSpeed, float timeDelta, size_t n) {
+	size_t i = 0;
+#if defined(SIMD_AVX2)
+	__m256 dt = _mm256_set1_ps(timeDelta);
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(angle + i, _mm256_add_ps(_mm256_loadu_ps(angle + i), _mm256_mul_ps(_mm256_loadu_ps(rotateSpeed + i), dt)));
+#elif defined(SIMD_SSE2)
+	__m128 dt = _mm_set1_ps(timeDelta);
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(angle + i, _mm_add_ps(_mm_loadu_ps(angle + i), _mm_mul_ps(_mm_loadu_ps(rotateSpeed + i), dt)));
+#endif
+	for (; i < n; i++)
+		angle[i] += rotateSpeed[i] * timeDelta;
+}
+
+// scale = base + dance * sin(freq * time), what ScaleBehavior did for one shape
+void scaleDanceBatch(float *scale, const float *base, const float *dance, const float *freq, float time, size_t n) {
+	size_t i = 0;
+#if defined(SIMD_AVX2)
+	__m256 t = _mm256_set1_ps(time);
+	for (; i + 8 <= n; i += 8) {
+		__m256 s = fastSin8(_mm256_mul_ps(_mm256_loadu_ps(freq + i), t));
+		_mm256_storeu_ps(scale + i, _mm256_add_ps(_mm256_loadu_ps(base + i), _mm256_mul_ps(_mm256_loadu_ps(dance + i), s)));
+	}
+#elif defined(SIMD_SSE2)
+	__m128 t = _mm_set1_ps(time);
+	for (; i + 4 <= n; i += 4) {
+		__m128 s = fastSin4(_mm_mul_ps(_mm_loadu_ps(freq + i), t));
+		_mm_storeu_ps(scale + i, _mm_add_ps(_mm_loadu_ps(base + i), _mm_mul_ps(_mm_loadu_ps(dance + i), s)));
+	}
+#endif
+	for (; i < n; i++)
+		scale[i] = base[i] + dance[i] * fastSin(freq[i] * time);
+}
+
+// one semi-implicit Euler step with drag and the window clamp, the rules the player has always moved by
+inline void integratePoint(float &x, float &y, float &vx, float &vy, float ax, float ay, float dt, float drag, Vector2f min, Vector2f max) {
+	vx += ax * dt;
+	vy += ay * dt;
+	x += vx * dt;
+	y += vy * dt;
+	vx *= 1 - drag;
+	vy *= 1 - drag;
+	x = std::min(std::max(x, min.x), max.x);
+	y = std::min(std::max(y, min.y), max.y);
+}
+
+// integratePoint over arrays of points
+void integrateBatch(float *x, float *y, float *vx, float *vy, const float *ax, const float *ay,
+	float dt, float drag, Vector2f min, Vector2f max, size_t n) {
+	size_t i = 0;
+#if defined(SIMD_AVX2)
+	__m256 t = _mm256_set1_ps(dt), keep = _mm256_set1_ps(1 - drag);
+	__m256 minX = _mm256_set1_ps(min.x), minY = _mm256_set1_ps(min.y);
+	__m256 maxX = _mm256_set1_ps(max.x), maxY = _mm256_set1_ps(max.y);
+	for (; i + 8 <= n; i += 8) {
+		__m256 velocityX = _mm256_add_ps(_mm256_loadu_ps(vx + i), _mm256_mul_ps(_mm256_loadu_ps(ax + i), t));
+		__m256 velocityY = _mm256_add_ps(_mm256_loadu_ps(vy + i), _mm256_mul_ps(_mm256_loadu_ps(ay + i), t));
+		__m256 positionX = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(velocityX, t));
+		__m256 positionY = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(velocityY, t));
+		_mm256_storeu_ps(vx + i, _mm256_mul_ps(velocityX, keep));
+		_mm256_storeu_ps(vy + i, _mm256_mul_ps(velocityY, keep));
+		_mm256_storeu_ps(x + i, _mm256_min_ps(_mm256_max_ps(positionX, minX), maxX));
+		_mm256_storeu_ps(y + i, _mm256_min_ps(_mm256_max_ps(positionY, minY), maxY));
+	}
+#elif defined(SIMD_SSE2)
+	__m128 t = _mm_set1_ps(dt), keep = _mm_set1_ps(1 - drag);
+	__m128 minX = _mm_set1_ps(min.x), minY = _mm_set1_ps(min.y);
+	__m128 maxX = _mm_set1_ps(max.x), maxY = _mm_set1_ps(max.y);
+	for (; i + 4 <= n; i += 4) {
+		__m128 velocityX = _mm_add_ps(_mm_loadu_ps(vx + i), _mm_mul_ps(_mm_loadu_ps(ax + i), t));
+		__m128 velocityY = _mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(_mm_loadu_ps(ay + i), t));
+		__m128 positionX = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(velocityX, t));
+		__m128 positionY = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(velocityY, t));
+		_mm_storeu_ps(vx + i, _mm_mul_ps(velocityX, keep));
+		_mm_storeu_ps(vy + i, _mm_mul_ps(velocityY, keep));
+		_mm_storeu_ps(x + i, _mm_min_ps(_mm_max_ps(positionX, minX), maxX));
+		_mm_storeu_ps(y + i, _mm_min_ps(_mm_max_ps(positionY, minY), maxY));
+	}
+#endif
+	for (; i < n; i++)
+		integratePoint(x[i], y[i], vx[i], vy[i], ax[i], ay[i], dt, drag, min, max);
+}
+
+// compares the batch kernels with the plain scalar update they replaced,
+// returns false when any result is further off than float rounding can explain
+bool checkBatchKernels() {
+	const float epsilon = std::numeric_limits<float>::epsilon();
+	const size_t n = 10003; // not a multiple of the vector width so the scalar tail runs too
+	std::vector<float> angle(n), expectedAngle(n), rotateSpeed(n);
+	std::vector<float> scale(n), base(n), dance(n), freq(n);
+	for (size_t i = 0; i < n; i++) {
+		angle[i] = expectedAngle[i] = (float)(rand() % 3600) / 10;
+		rotateSpeed[i] = (float)(rand() % 300 - 150);
+		base[i] = 1;
+		dance[i] = (rand() % 20) / 19.0f;
+		freq[i] = 0.1f + (rand() % 100) / 10.0f;
+	}
+	// the errors are in float epsilons of the size of the operands, one frame at a time so nothing adds up.
+	// the vector paths do what the scalar ones do, so they only differ if the compiler fuses a scalar multiply and add
+	float maxAngleError = 0, maxScaleError = 0, maxSinError = 0;
+	float time = 0;
+	for (int frame = 0; frame < 600; frame++) {
+		float timeDelta = 1 / 60.0f;
+		time += 3.7f; // run far ahead so the range reduction gets tested on large arguments
+		for (size_t i = 0; i < n; i++)
+			expectedAngle[i] = angle[i] + rotateSpeed[i] * timeDelta;
+		rotateBatch(&angle[0], &rotateSpeed[0], timeDelta, n);
+		scaleDanceBatch(&scale[0], &base[0], &dance[0], &freq[0], time, n);
+		for (size_t i = 0; i < n; i++) {
+			float size = fabsf(expectedAngle[i]) + fabsf(rotateSpeed[i] * timeDelta);
+			maxAngleError = std::max(maxAngleError, fabsf(angle[i] - expectedAngle[i]) / (size * epsilon));
+			float expectedScale = base[i] + dance[i] * fastSin(freq[i] * time);
+			maxScaleError = std::max(maxScaleError, fabsf(scale[i] - expectedScale) / ((fabsf(base[i]) + fabsf(dance[i])) * epsilon));
+			// and the sine itself against the C library, whose results are never more than 1 away from 0
+			maxSinError = std::max(maxSinError, fabsf(fastSin(freq[i] * time) - sinf(freq[i] * time)) / epsilon);
+		}
+	}
+	// particles against the player's own step, also from the same state every step and in epsilons of the operands
+	std::vector<float> x(n), y(n), vx(n), vy(n), ax(n), ay(n);
+	std::vector<float> expectedX(n), expectedY(n), expectedVx(n), expectedVy(n);
+	Vector2f min = { -400, -300 }, max = { 400, 300 };
+	for (size_t i = 0; i < n; i++) {
+		x[i] = expectedX[i] = (float)(rand() % 800 - 400);
+		y[i] = expectedY[i] = (float)(rand() % 600 - 300);
+		vx[i] = expectedVx[i] = (float)(rand() % 2000 - 1000);
+		vy[i] = expectedVy[i] = (float)(rand() % 2000 - 1000);
+		ax[i] = 0;
+		ay[i] = -1000;
+	}
+	float maxPositionError = 0;
+	for (int step = 0; step < 600; step++) {
+		float dt = 1 / 60.0f;
+		expectedX = x;
+		expectedY = y;
+		expectedVx = vx;
+		expectedVy = vy;
+		integrateBatch(&x[0], &y[0], &vx[0], &vy[0], &ax[0], &ay[0], dt, 0.01f, min, max, n);
+		for (size_t i = 0; i < n; i++) {
+			float sizeX = fabsf(expectedX[i]) + (fabsf(expectedVx[i]) + fabsf(ax[i] * dt)) * dt;
+			float sizeY = fabsf(expectedY[i]) + (fabsf(expectedVy[i]) + fabsf(ay[i] * dt)) * dt;
+			integratePoint(expectedX[i], expectedY[i], expectedVx[i], expectedVy[i], ax[i], ay[i], dt, 0.01f, min, max);
+			maxPositionError = std::max(maxPositionError, std::max(fabsf(x[i] - expectedX[i]) / (sizeX * epsilon),
+				fabsf(y[i] - expectedY[i]) / (sizeY * epsilon)));
+		}
+	}
+	// triangle spans against the weights and colors worked out one pixel at a time
+	int maxChannelError = 0, coverageMismatches = 0, spanPixels = 0;
+	std::vector<uint32_t> row(300);
+	for (int test = 0; test < 2000; test++) {
+		SoftwareRenderer::TriangleSpan span;
+		span.left = (rand() % 10000 - 5000) / 100.0f; // whole in the renderer, but nothing should depend on it
+		for (int i = 0; i < 3; i++) {
+			span.base[i] = (rand() % 2001 - 1000) / 1000.0f;
+			span.step[i] = (rand() % 201 - 100) / 5000.0f;
+			span.color[i] = getRandomColor();
+		}
+		int x0 = rand() % 150, x1 = x0 + rand() % 150;
+		std::fill(row.begin(), row.end(), 0u);
+		SoftwareRenderer::fillTriangleSpan(&row[0], x0, x1, span);
+		for (int x = 0; x < (int)row.size(); x++) {
+			float k = x - span.left;
+			float w[3];
+			for (int i = 0; i < 3; i++)
+				w[i] = span.base[i] + span.step[i] * k;
+			bool inside = x >= x0 && x <= x1 && w[0] >= 0 && w[1] >= 0 && w[2] >= 0;
+			spanPixels++;
+			if (inside != (row[x] != 0)) {
+				coverageMismatches++;
+				continue;
+			}
+			if (!inside) continue;
+			uint32_t expected = SoftwareRenderer::pack({
+				w[0] * span.color[0].x + w[1] * span.color[1].x + w[2] * span.color[2].x,
+				w[0] * span.color[0].y + w[1] * span.color[1].y + w[2] * span.color[2].y,
+				w[0] * span.color[0].z + w[1] * span.color[1].z + w[2] * span.color[2].z });
+			for (int channel = 0; channel < 32; channel += 8)
+				maxChannelError = std::max(maxChannelError, abs((int)(row[x] >> channel & 0xff) - (int)(expected >> channel & 0xff)));
+		}
+	}
+	std::cout << "Batch kernel max angle error: " << maxAngleError << " epsilons" << std::endl;
+	std::cout << "Batch kernel max scale error: " << maxScaleError << " epsilons, sine against sinf: " << maxSinError << " epsilons" << std::endl;
+	std::cout << "Batch kernel max particle position error: " << maxPositionError << " epsilons" << std::endl;
+	std::cout << "Span kernel max channel error: " << maxChannelError << ", coverage mismatches: "
+		<< coverageMismatches << " of " << spanPixels << " pixels" << std::endl;
+	// the span fill replaced a scalar loop, so every pixel has to be exactly what that loop wrote
+	return maxAngleError <= 1 && maxScaleError <= 4 && maxSinError <= 8 && maxPositionError <= 2 &&
+		maxChannelError == 0 && coverageMismatches == 0;
+}
+
+// owns objects of one type in fixed blocks that never move, so pointers stay valid until despawned.
+// despawned slots are reused before a new block is allocated, and the live objects are kept in one packed list
+template<typename T, int BLOCK_SIZE = 64>
+struct ObjectPool {
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+	std::vector<std::unique_ptr<Storage[]>> blocks;
+	std::vector<T*> freeSlots;
+	std::vector<T*> live;
+	uint64_t spawned = 0;
+	uint64_t despawned = 0;
+	~ObjectPool() {
+		clear();
+	}
+	size_t size() const {
+		return live.size();
+	}
+	size_t capacity() const {
+		return blocks.size() * BLOCK_SIZE;
+	}
+	template<typename... Args>
+	T *spawn(Args&&... args) {
+		if (freeSlots.empty()) grow();
+		T *object = freeSlots.back();
+		freeSlots.pop_back();
+		new (object) T(std::forward<Args>(args)...);
+		live.push_back(object);
+		spawned++;
+		return object;
+	}
+	void despawn(T *object) {
+		typename std::vector<T*>::iterator it = std::find(live.begin(), live.end(), object);
+		if (it == live.end()) return;
+		*it = live.back();
+		live.pop_back();
+		object->~T();
+		freeSlots.push_back(object);
+		despawned++;
+	}
+	// destroys every live object, the blocks are kept for the next spawns
+	void clear() {
+		for (size_t i = 0; i < live.size(); i++) {
+			live[i]->~T();
+			freeSlots.push_back(live[i]);
+		}
+		despawned += live.size();
+		live.clear();
+	}
+	void grow() {
+		blocks.push_back(std::unique_ptr<Storage[]>(new Storage[BLOCK_SIZE]));
+		// reserve up front so neither list has to reallocate while spawning into this block
+		freeSlots.reserve(capacity());
+		live.reserve(capacity());
+		for (int i = BLOCK_SIZE - 1; i >= 0; i--)
+			freeSlots.push_back(reinterpret_cast<T*>(&blocks.back()[i]));
+	}
+};
+
+// refers to an entity inside a store, stays valid while other entities are added and removed
+struct EntityHandle {
+	int slot = -1;
+	int generation = 0;
+};
+
+const float GRID_CELL_SIZE = 64; // starting cell size, cells shrink as the population grows
+const float GRID_MIN_CELL_SIZE = 4;
+const int GRID_DENSITY = 4; // entities per cell on average before the cells are halved
+
+// buckets ids by the cell their center falls in, over a fixed world rectangle. anything outside
+// the rectangle goes to the nearest edge cell. entities bigger than a cell are still found because
+// queries are widened by the largest bound the owner has seen. every cell is a list linked through
+// arrays indexed by id, so moving between cells never allocates however crowded a cell gets
+struct SpatialGrid {
+	Vector2f origin;
+	float cellSize = 0;
+	int columns = 0, rows = 0;
+	std::vector<int> cells; // the first id of every cell, -1 for an empty one
+	std::vector<int> idCell; // -1 when the id is not in the grid
+	std::vector<int> idNext, idPrevious; // the neighbours in its cell, -1 at either end
+
+	void resize(Vector2f origin, Vector2f size, float cellSize) {
+		this->origin = origin;
+		this->cellSize = cellSize;
+		columns = std::max((int)ceil(size.x / cellSize), 1);
+		rows = std::max((int)ceil(size.y / cellSize), 1);
+		cells.assign(columns * rows, -1);
+		idCell.assign(idCell.size(), -1);
+	}
+	int column(float x) const {
+		return std::min(std::max((int)floor((x - origin.x) / cellSize), 0), columns - 1);
+	}
+	int row(float y) const {
+		return std::min(std::max((int)floor((y - origin.y) / cellSize), 0), rows - 1);
+	}
+	int cellOf(Vector2f p) const {
+		return row(p.y) * columns + column(p.x);
+	}
+	void insert(int id, Vector2f p) {
+		if (id >= (int)idCell.size()) {
+			idCell.resize(id + 1, -1);
+			idNext.resize(id + 1, -1);
+			idPrevious.resize(id + 1, -1);
+		}
+		int cell = cellOf(p);
+		idCell[id] = cell;
+		idPrevious[id] = -1;
+		idNext[id] = cells[cell];
+		if (cells[cell] >= 0) idPrevious[cells[cell]] = id;
+		cells[cell] = id;
+	}
+	void erase(int id) {
+		int cell = idCell[id];
+		if (cell < 0) return;
+		if (idPrevious[id] >= 0)
+			idNext[idPrevious[id]] = idNext[id];
+		else
+			cells[cell] = idNext[id];
+		if (idNext[id] >= 0) idPrevious[idNext[id]] = idPrevious[id];
+		idCell[id] = -1;
+	}
+	// only touches the cells when the id actually crosses into another one
+	void move(int id, Vector2f p) {
+		if (idCell[id] == cellOf(p)) return;
+		erase(id);
+		insert(id, p);
+	}
+	void clear() {
+		std::fill(cells.begin(), cells.end(), -1);
+		idCell.assign(idCell.size(), -1);
+	}
+	// calls visit(id) for everything bucketed in the cells overlapping the rectangle
+	template <typename Visit>
+	void forEachInRect(Vector2f min, Vector2f max, Visit visit) const {
+		int c0 = column(min.x), c1 = column(max.x);
+		int r0 = row(min.y), r1 = row(max.y);
+		for (int r = r0; r <= r1; r++)
+			for (int c = c0; c <= c1; c++)
+				for (int id = cells[r * columns + c]; id >= 0; id = idNext[id])
+					visit(id);
+	}
+	// calls visit(id) for the cells exactly ring cells away from the cell of p, ring 0 is the cell itself
+	template <typename Visit>
+	bool forEachInRing(Vector2f p, int ring, Visit visit) const {
+		int c = column(p.x), r = row(p.y);
+		if (c - ring < 0 && c + ring >= columns && r - ring < 0 && r + ring >= rows) return false;
+		for (int y = r - ring; y <= r + ring; y++) {
+			if (y < 0 || y >= rows) continue;
+			bool edgeRow = y == r - ring || y == r + ring;
+			for (int x = c - ring; x <= c + ring; x += edgeRow || ring == 0 ? 1 : 2 * ring) {
+				if (x < 0 || x >= columns) continue;
+				for (int id = cells[y * columns + x]; id >= 0; id = idNext[id])
+					visit(id);
+			}
+		}
+		return true;
+	}
+};
+
+// every rotating and scale-dancing shape of one kind, stored as one array per field
+// so the whole population is updated by tight loops instead of a virtual call per shape
+template <typename Shape>
+struct ShapeStore : public IDrawable, public IUpdateBehavior {
+	std::vector<Vector2f> pos;
+	std::vector<float> angle;
+	std::vector<float> scale;
+	std::vector<float> rotateSpeed; // degrees per second
+	// scale = scaleBase + scaleDance * sin(scaleDanceFreq * time)
+	std::vector<float> scaleBase;
+	std::vector<float> scaleDance;
+	std::vector<float> scaleDanceFreq;
+	std::vector<Shape> shapes;
+	// the arrays above stay packed, handles find their entity through these
+	std::vector<int> slotToIndex; // -1 for a free slot
+	std::vector<int> slotGeneration;
+	std::vector<int> indexToSlot;
+	std::vector<int> freeSlots;
+	// spatial index over the slots, bound is the radius around pos that holds the shape at scale 1
+	std::vector<float> bound;
+	float maxBound = 0; // largest bound times the largest scale the dance can reach
+	SpatialGrid grid;
+	std::vector<char> drawnLast; // skipped by draw, ClickedShapes draws these on top of the scene
+
+	size_t size() const {
+		return pos.size();
+	}
+	EntityHandle add(const Shape &shape, Vector2f p, float rotateSpeed, float scaleDance) {
+		EntityHandle handle;
+		if (freeSlots.empty()) {
+			handle.slot = (int)slotToIndex.size();
+			slotToIndex.push_back(-1);
+			slotGeneration.push_back(0);
+		}
+		else {
+			handle.slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		handle.generation = slotGeneration[handle.slot];
+		slotToIndex[handle.slot] = (int)size();
+		indexToSlot.push_back(handle.slot);
+		shapes.push_back(shape);
+		pos.push_back(p);
+		angle.push_back(0);
+		scale.push_back(1);
+		this->rotateSpeed.push_back(rotateSpeed);
+		scaleBase.push_back(1);
+		this->scaleDance.push_back(scaleDance);
+		scaleDanceFreq.push_back(1);
+		bound.push_back(boundingRadius(shape));
+		drawnLast.push_back(0);
+		maxBound = std::max(maxBound, bound.back() * (1 + fabsf(scaleDance)));
+		if (grid.cells.empty())
+			grid.resize({ -W / 2.0f, -H / 2.0f }, { (float)W, (float)H }, GRID_CELL_SIZE);
+		grid.insert(handle.slot, p);
+		if (size() > GRID_DENSITY * grid.cells.size() && grid.cellSize > GRID_MIN_CELL_SIZE)
+			rebuildGrid(std::max(grid.cellSize / 2, GRID_MIN_CELL_SIZE));
+		return handle;
+	}
+	// returns where the entity is in the arrays, or -1 when it was removed
+	int indexOf(EntityHandle handle) const {
+		if (handle.slot < 0 || handle.slot >= (int)slotToIndex.size()) return -1;
+		if (slotGeneration[handle.slot] != handle.generation) return -1;
+		return slotToIndex[handle.slot];
+	}
+	void remove(EntityHandle handle) {
+		int i = indexOf(handle);
+		if (i < 0) return;
+		// fill the hole with the last entity so the arrays stay packed
+		int last = (int)size() - 1;
+		pos[i] = pos[last];
+		angle[i] = angle[last];
+		scale[i] = scale[last];
+		rotateSpeed[i] = rotateSpeed[last];
+		scaleBase[i] = scaleBase[last];
+		scaleDance[i] = scaleDance[last];
+		scaleDanceFreq[i] = scaleDanceFreq[last];
+		bound[i] = bound[last];
+		drawnLast[i] = drawnLast[last];
+		shapes[i] = shapes[last];
+		indexToSlot[i] = indexToSlot[last];
+		slotToIndex[indexToSlot[i]] = i;
+		pos.pop_back();
+		angle.pop_back();
+		scale.pop_back();
+		rotateSpeed.pop_back();
+		scaleBase.pop_back();
+		scaleDance.pop_back();
+		scaleDanceFreq.pop_back();
+		bound.pop_back();
+		drawnLast.pop_back();
+		shapes.pop_back();
+		indexToSlot.pop_back();
+		grid.erase(handle.slot);
+		slotToIndex[handle.slot] = -1;
+		slotGeneration[handle.slot]++;
+		freeSlots.push_back(handle.slot);
+	}
+	// removes every entity at once, handles given out before stay invalid
+	void clear() {
+		for (size_t i = 0; i < indexToSlot.size(); i++) {
+			slotToIndex[indexToSlot[i]] = -1;
+			slotGeneration[indexToSlot[i]]++;
+			freeSlots.push_back(indexToSlot[i]);
+		}
+		pos.clear();
+		angle.clear();
+		scale.clear();
+		rotateSpeed.clear();
+		scaleBase.clear();
+		scaleDance.clear();
+		scaleDanceFreq.clear();
+		bound.clear();
+		drawnLast.clear();
+		shapes.clear();
+		indexToSlot.clear();
+		grid.clear();
+		maxBound = 0;
+	}
+	void rebuildGrid(float cellSize) {
+		grid.resize(grid.origin, { grid.columns * grid.cellSize, grid.rows * grid.cellSize }, cellSize);
+		for (size_t i = 0; i < size(); i++)
+			grid.insert(indexToSlot[i], pos[i]);
+	}
+	// moves an entity and keeps the grid up to date, write pos only through here
+	void moveTo(int i, Vector2f p) {
+		pos[i] = p;
+		grid.move(indexToSlot[i], p);
+	}
+	float boundOf(int i) const {
+		return bound[i] * scale[i];
+	}
+	// calls visit(index) for every entity whose bounding circle overlaps the circle at center
+	template <typename Visit>
+	void queryRange(Vector2f center, float range, Visit visit) const {
+		if (grid.cells.empty()) return;
+		float reach = range + maxBound;
+		grid.forEachInRect({ center.x - reach, center.y - reach }, { center.x + reach, center.y + reach }, [&](int slot) {
+			int i = slotToIndex[slot];
+			float r = range + boundOf(i);
+			if (sqrDistance(pos[i], center) <= r * r) visit(i);
+		});
+	}
+	// index of the entity with its position closest to p, -1 when the store is empty
+	int nearest(Vector2f p) const {
+		int best = -1;
+		float bestDistance = 0;
+		if (grid.cells.empty()) return best;
+		// everything in a ring further out is at least ring cells away, so stop once the best is closer
+		for (int ring = 0; best < 0 || bestDistance > (ring - 1) * grid.cellSize * (ring - 1) * grid.cellSize; ring++) {
+			bool inside = grid.forEachInRing(p, ring, [&](int slot) {
+				int i = slotToIndex[slot];
+				float d = sqrDistance(pos[i], p);
+				if (best < 0 || d < bestDistance) {
+					best = i;
+					bestDistance = d;
+				}
+			});
+			if (!inside) break;
+		}
+		return best;
+	}
+	// calls visit(a, b) once for every two entities whose bounding circles overlap
+	template <typename Visit>
+	void queryPairs(Visit visit) const {
+		for (int i = 0; i < (int)size(); i++)
+			queryRange(pos[i], boundOf(i), [&](int j) {
+				if (j > i) visit(i, j);
+			});
+	}
+	void update(float time, float timeDelta) {
+		jobs.parallelFor((int)size(), 4096, [this, time, timeDelta](int begin, int end) {
+			rotateBatch(&angle[begin], &rotateSpeed[begin], timeDelta, end - begin);
+			scaleDanceBatch(&scale[begin], &scaleBase[begin], &scaleDance[begin], &scaleDanceFreq[begin], time, end - begin);
+		});
+	}
+	int getProfilePhase() {
+		return PHASE_DRAW_SHAPES;
+	}
+	// leaves the entity for someone else to draw, it is still updated, moved and collided with as before
+	void setDrawnLast(EntityHandle handle) {
+		int i = indexOf(handle);
+		if (i >= 0) drawnLast[i] = 1;
+	}
+	// how far back the angles have to be turned to get the drawn frame,
+	// rotation is linear, so the angle between the last two steps is easy to get back
+	float rewind() const {
+		return (1 - renderAlpha()) * timeDelta();
+	}
+	void drawEntity(int i, float rewind) {
+		float r = boundOf(i);
+		Bounds box = { { pos[i].x - r, pos[i].y - r }, { pos[i].x + r, pos[i].y + r } };
+		if (!box.overlaps(viewBounds)) {
+			itemsCulled++;
+			return;
+		}
+		setDefaultColor();
+		setDefaultLineWidth();
+		drawShape(shapes[i], pos[i], angle[i] - rotateSpeed[i] * rewind, scale[i]);
+	}
+	void draw() {
+		float rewind = this->rewind();
+		for (size_t i = 0; i < size(); i++)
+			if (!drawnLast[i])
+				drawEntity((int)i, rewind);
+	}
+};
+
+// shapes spawned by clicking live in the stores like the rest, but are drawn after the whole scene in the
+// order they were clicked, each in a layer of its own, so the newest one is always on top as it used to be
+struct ClickedShapes : public IDrawable {
+	ShapeStore<Circle> *circles;
+	ShapeStore<Triangle> *triangles;
+	std::vector<EntityHandle> handles;
+	std::vector<char> isCircle;
+	ClickedShapes(ShapeStore<Circle> *circles, ShapeStore<Triangle> *triangles) : circles(circles), triangles(triangles) {
+	}
+	void addCircle(EntityHandle handle) {
+		circles->setDrawnLast(handle);
+		handles.push_back(handle);
+		isCircle.push_back(1);
+	}
+	void addTriangle(EntityHandle handle) {
+		triangles->setDrawnLast(handle);
+		handles.push_back(handle);
+		isCircle.push_back(0);
+	}
+	// takes the shapes out of their stores as well
+	void removeAll() {
+		for (size_t i = 0; i < handles.size(); i++) {
+			if (isCircle[i])
+				circles->remove(handles[i]);
+			else
+				triangles->remove(handles[i]);
+		}
+		clear();
+	}
+	// forgets the shapes, for when the stores have already been emptied
+	void clear() {
+		handles.clear();
+		isCircle.clear();
+	}
+	int getProfilePhase() {
+		return PHASE_DRAW_SHAPES;
+	}
+	void draw() {
+		float rewind = circles->rewind();
+		for (size_t i = 0; i < handles.size(); i++) {
+			renderQueue.setLayer(renderQueue.layer + 1);
+			if (isCircle[i]) {
+				int index = circles->indexOf(handles[i]);
+				if (index >= 0) circles->drawEntity(index, rewind);
+			}
+			else {
+				int index = triangles->indexOf(handles[i]);
+				if (index >= 0) triangles->drawEntity(index, rewind);
+			}
+		}
+	}
+};
+
+// lets a PathFollowingBehavior move an entity that lives in a store
+template <typename Shape>
+struct ShapeMover : public IMover {
+	ShapeStore<Shape> *store;
+	EntityHandle handle;
+	ShapeMover(ShapeStore<Shape> *store, EntityHandle handle) : store(store), handle(handle) {
+	}
+	void move(Vector2f position) {
+		int i = store->indexOf(handle);
+		if (i >= 0) store->moveTo(i, position);
+	}
+	Vector2f getPosition() {
+		int i = store->indexOf(handle);
+		return i >= 0 ? store->pos[i] : Vector2f{ 0, 0 };
+	}
+};
+
+// points thrown around by gravity and drag like the player, one array per field. when the limit is
+// reached new particles replace the oldest ones, so a full system never allocates again
+struct ParticleSystem : public IDrawable, public IUpdateBehavior {
+	std::vector<float> x, y;
+	std::vector<float> vx, vy;
+	std::vector<float> ax, ay;
+	std::vector<float> previousX, previousY; // where the last step started, for drawing in between steps
+	std::vector<ColorVertex> vertices;
+	size_t limit = PARTICLE_LIMIT;
+	size_t next = 0; // the oldest particle, overwritten first once the system is full
+	float pointSize = 2;
+	float gravity = GRAVITY, drag = PLAYER_DRAG; // the same as the player of its world
+
+	size_t size() const {
+		return x.size();
+	}
+	void emit(Vector2f p, Vector2f v, Vector3f color) {
+		size_t i = next;
+		if (size() < limit) {
+			i = size();
+			x.push_back(0); y.push_back(0);
+			vx.push_back(0); vy.push_back(0);
+			ax.push_back(0); ay.push_back(0);
+			previousX.push_back(0); previousY.push_back(0);
+			vertices.push_back(ColorVertex());
+		}
+		else
+			next = (next + 1) % limit;
+		x[i] = previousX[i] = p.x;
+		y[i] = previousY[i] = p.y;
+		vx[i] = v.x;
+		vy[i] = v.y;
+		ax[i] = 0;
+		ay[i] = -gravity;
+		vertices[i].color = color;
+	}
+	// a fan of particles shot upwards from p
+	void burst(Vector2f p, int count, float speed) {
+		for (int i = 0; i < count; i++) {
+			float angle = (20 + worldRandom() % 140) * PI / 180;
+			float s = speed * (0.3f + 0.7f * (worldRandom() % 1000) / 999.0f);
+			emit(p, { s * cosf(angle), s * sinf(angle) }, getRandomColor());
+		}
+	}
+	void clear() {
+		x.clear(); y.clear();
+		vx.clear(); vy.clear();
+		ax.clear(); ay.clear();
+		previousX.clear(); previousY.clear();
+		vertices.clear();
+		next = 0;
+	}
+	void update(float time, float timeDelta) {
+		Vector2f min = { -W / 2.0f, -H / 2.0f }, max = { W / 2.0f, H / 2.0f };
+		jobs.parallelFor((int)size(), 16384, [this, timeDelta, min, max](int begin, int end) {
+			std::copy(x.begin() + begin, x.begin() + end, previousX.begin() + begin);
+			std::copy(y.begin() + begin, y.begin() + end, previousY.begin() + begin);
+			integrateBatch(&x[begin], &y[begin], &vx[begin], &vy[begin], &ax[begin], &ay[begin],
+				timeDelta, drag, min, max, end - begin);
+		});
+	}
+	int getProfilePhase() {
+		return PHASE_DRAW_PARTICLES;
+	}
+	// every particle goes out in a single point draw
+	void draw() {
+		if (x.empty()) return;
+		float alpha = renderAlpha();
+		jobs.parallelFor((int)size(), 16384, [this, alpha](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				vertices[i].pos = { previousX[i] + (x[i] - previousX[i]) * alpha, previousY[i] + (y[i] - previousY[i]) * alpha };
+		});
+		renderer->pointSize(pointSize);
+		renderer->drawArrays(GL_POINTS, &vertices[0], (int)size());
+	}
+};
+
+// everything one scene owns: what it spawned, its player, its clock and its random numbers. the code
+// works on the world of the thread it runs on, so many worlds can be stepped side by side
+struct World {
+	std::vector<IUpdateBehavior*> updateBehaviors;
+	std::vector<IDrawable*> drawables;
+	std::vector<Vector2f> points;
+	Vector2f playerPosition = { -326, -263 };
+	Vector2f previousPlayerPosition = playerPosition; // where the player was one simulation step ago
+	Vector2f playerVelocity = { 0, 0 };
+	Vector2f playerAcceleration = { 0, -GRAVITY };
+	float playerAngle = 0;
+	float gravity = GRAVITY, playerDrag = PLAYER_DRAG;
+	duration<double> time = duration<double>::zero(); // simulated time since the scene was built
+	duration<double> timeDelta = duration<double>::zero(); // always FIXED_TIME_STEP while simulating
+	duration<double> accumulator = duration<double>::zero(); // real time that has not been simulated yet
+	float renderAlpha = 1; // how far the drawn frame is between the previous and the latest simulation step
+	uint32_t steps = 0; // taken since the scene was built, recorded input is timed by it
+	uint32_t randomSeed = 0;
+	uint64_t randomCount = 0; // numbers drawn since seeding
+	size_t replayNext = 0; // the first replayed event not handled yet
+	std::vector<Tree*> trees;
+	std::vector<TreeBehavior*> mainTree;
+	std::vector<SineWaveBehavior*> mainWave;
+	std::vector<PathFollowingBehavior*> following;
+	TrackingLine *trackingLine = NULL;
+	ShapeStore<Circle> circles;
+	ShapeStore<Triangle> triangles;
+	ParticleSystem particles;
+	// everything the gen functions spawn lives in these, reset empties them all at once
+	ObjectPool<Tree> treePool;
+	ObjectPool<TreeBehavior> treeBehaviorPool;
+	ObjectPool<SineWave> wavePool;
+	ObjectPool<SineWaveBehavior> waveBehaviorPool;
+	ObjectPool<PathFollowingBehavior> followerPool;
+	ObjectPool<ShapeMover<Circle>> circleMoverPool;
+	ObjectPool<TrackingLine, 1> trackingLinePool;
+	ObjectPool<Path, 4> pathPool;
+	// shapes spawned by clicking, so they can be drawn last and cleared from the menu
+	ClickedShapes clicked{ &circles, &triangles };
+
+	// a rand of its own, so worlds on different threads neither share nor disturb each other's numbers
+	void seed(uint32_t seed) {
+		randomSeed = seed;
+		randomCount = 0;
+	}
+	int random() {
+		return hashRandom(randomSeed, randomCount++);
+	}
+	// the particles fall and slow down like the player
+	void setPhysics(float newGravity, float newDrag) {
+		playerAcceleration.y += gravity - newGravity;
+		gravity = particles.gravity = newGravity;
+		playerDrag = particles.drag = newDrag;
+	}
+	// removes everything the scene and the gen functions created, and rewinds time and the player
+	void reset() {
+		treePool.clear();
+		treeBehaviorPool.clear();
+		wavePool.clear();
+		waveBehaviorPool.clear();
+		followerPool.clear();
+		circleMoverPool.clear();
+		trackingLinePool.clear();
+		pathPool.clear();
+		trackingLine = NULL;
+		clicked.clear();
+		trees.clear();
+		mainTree.clear();
+		mainWave.clear();
+		following.clear();
+		drawables.clear();
+		updateBehaviors.clear();
+		points.clear();
+		circles.clear();
+		triangles.clear();
+		particles.clear();
+		time = timeDelta = accumulator = duration<double>::zero();
+		steps = 0;
+		replayNext = 0;
+		playerPosition = previousPlayerPosition = { -326, -263 };
+		playerVelocity = { 0, 0 };
+		playerAcceleration = { 0, -gravity };
+		playerAngle = 0;
+	}
+};
+
+World mainWorld; // the one the window, the benchmarks and the other single scene modes play
+thread_local World *world = &mainWorld;
+
+double time() {
+	return world->time.count(); // returns time since the scene was built in seconds
+}
+
+double timeDelta() { // time between last frame and current frame
+	return world->timeDelta.count();
+}
+
+float renderAlpha() {
+	return world->renderAlpha;
+}
+
+int worldRandom() {
+	return world->random();
+}
+
+void drawRect(int glPrimitve, float w, float h) {
+	// pivot is at the base
+	renderer->begin(glPrimitve);
+	renderer->vertex(-w / 2.0f, 0);
+	renderer->vertex(w / 2.0f, 0);
+	renderer->vertex(w / 2.0f, h);
+	renderer->vertex(-w / 2.0f, h);
+	renderer->end();
+}
+
+void drawPlayer(float rad, Vector2f gunSize) {
+	Vector2f pos = {
+		world->previousPlayerPosition.x + (world->playerPosition.x - world->previousPlayerPosition.x) * world->renderAlpha,
+		world->previousPlayerPosition.y + (world->playerPosition.y - world->previousPlayerPosition.y) * world->renderAlpha
+	};
+	renderer->pushMatrix();
+	renderer->translate(pos.x, pos.y);
+	renderer->color(0, 56 / 255.0f, 101 / 255.0f);
+	drawCircle(GL_POLYGON, { rad, rad });
+	renderer->rotate(world->playerAngle - 90);
+	drawRect(GL_LINE_LOOP, gunSize.x, gunSize.y);
+	renderer->popMatrix();
+}
+
+void display() {
+	renderer->clear(BACKGROUND_COLOR.x, BACKGROUND_COLOR.y, BACKGROUND_COLOR.z);
+	renderer->ortho2D(-W / 2, W / 2, -H / 2, H / 2);
+	viewBounds = { { -W / 2.0f, -H / 2.0f }, { W / 2.0f, H / 2.0f } };
+
+	// trees that changed since the last frame are regenerated side by side, each one also splits its big levels
+	{
+		ProfileScope scope(PHASE_TREE_GENERATION);
+		// the jobs may run on threads that play other worlds, so they are handed this one's trees
+		std::vector<Tree*> &trees = world->trees;
+		jobs.parallelFor((int)trees.size(), 1, [&trees](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				if (trees[i]->isGeometryDirty())
+					trees[i]->rebuildGeometry();
+		});
+	}
+
+	// drawables next to each other in the same category are timed as one phase, and share a layer of the queue
+	int64_t phaseStart = profiler.now();
+	renderQueue.setLayer(0);
+	for (size_t i = 0; i < world->drawables.size(); i++)
+	{
+		Bounds bounds;
+		if (world->drawables[i]->getBounds(bounds) && !bounds.overlaps(viewBounds))
+			itemsCulled++;
+		else {
+			setDefaultColor();
+			setDefaultLineWidth();
+			world->drawables[i]->draw();
+		}
+		int phase = world->drawables[i]->getProfilePhase();
+		if (i + 1 == world->drawables.size() || world->drawables[i + 1]->getProfilePhase() != phase) {
+			int64_t phaseEnd = profiler.now();
+			profiler.record(phase, phaseStart, phaseEnd);
+			phaseStart = phaseEnd;
+			renderQueue.setLayer(renderQueue.layer + 1);
+		}
+	}
+	{
+		ProfileScope scope(PHASE_DRAW_PLAYER);
+		setDefaultColor();
+		setDefaultLineWidth();
+		drawPlayer(PLAYER_RADIUS, { 10, 60 });
+	}
+	{
+		ProfileScope scope(PHASE_SUBMIT_BATCHES);
+		renderQueue.flush();
+	}
+	{
+		ProfileScope scope(PHASE_SWAP_BUFFERS);
+		renderer->swapBuffers();
+	}
+	profiler.endFrame();
+}
+
+Vector2f screenToWorld(int x, int y) {
+	float sx = x - W / 2.0f;
+	float sy = (H - y) - H / 2.0f;
+	return{ sx, sy };
+}
+
+EntityHandle genCircle(Vector2f p, float elipseScale=1.0) {
+	Circle circle;
+	float rad = 30 + world->random() % 30;
+	circle.radius = { rad * elipseScale, rad / elipseScale };
+	int ran = world->random() % 2;
+	if (ran)
+		circle.shiftFunc = sineShiftFunc;
+	else
+		circle.shiftFunc = analogSineShiftFunc;
+	circle.color = getRandomColor();
+	float rotateSpeed = world->random() % 300 - 150;
+	float scaleDance = (world->random() % 20) / 19.0;
+	return world->circles.add(circle, p, rotateSpeed, scaleDance);
+}
+
+EntityHandle genTriangle(Vector2f p) {
+	Triangle triangle;
+	for (int i = 0; i < 3; i++) {
+		float rx = 20 + world->random() % 50;
+		float ry = 20 + world->random() % 50;
+		if (world->random() % 2) rx = -rx;
+		if (world->random() % 2) ry = -ry;
+		triangle.points[i] = { rx, ry };
+		triangle.color[i] = getRandomColor();
+	}
+	triangle.center.x = (triangle.points[0].x + triangle.points[1].x + triangle.points[2].x) / 3.0f;
+	triangle.center.y = (triangle.points[0].y + triangle.points[1].y + triangle.points[2].y) / 3.0f;
+	triangle.middle = world->random() % 2;
+	float rotateSpeed = world->random() % 300 - 150;
+	float scaleDance = 0.5 * (world->random() % 20) / 19.0;
+	return world->triangles.add(triangle, p, rotateSpeed, scaleDance);
+}
+
+void click(int btn, int st, int x, int y) {
+	if (st == GLUT_DOWN && btn == GLUT_LEFT_BUTTON) {
+		Vector2f p = screenToWorld(x, y);
+		world->points.push_back(p);
+		//for (size_t i = 0; i < points.size(); i++)
+		//{
+		//	Vector2f p = points[i];
+		//	cout << "{" << p.x << "," << p.y << "}, ";
+		//}
+		//cout << endl;
+		//cout << "Clicked at: " << p.x << " " << p.y << endl;
+		//Point *apoint = new Point;
+		//apoint->pos = { p.x, p.y };
+		//drawables.push_back(apoint);
+
+		//Tree *tree = new Tree;
+		//tree->pos = { p.x, p.y };
+		//tree->startAngle = playerAngle - 90;
+		//tree->length = distance(tree->pos, playerPosition) * 0.3;
+		//tree->depth = 6;
+		//tree->splitAngle = 30;
+		//drawables.push_back(tree);
+		int ran = world->random() % 2;
+		if (ran)
+			world->clicked.addCircle(genCircle(p));
+		else
+			world->clicked.addTriangle(genTriangle(p));
+	}
+}
+
+// make player gun points toward the position
+void pointTowards(Vector2f p) {
+	world->playerAngle = atan2f(p.y - world->playerPosition.y, p.x - world->playerPosition.x) * 180 / PI;
+}
+
+void beforeRedisplay() {
+	// the same step the particles take, which also keeps the player inside the boundary
+	integratePoint(world->playerPosition.x, world->playerPosition.y, world->playerVelocity.x, world->playerVelocity.y,
+		world->playerAcceleration.x, world->playerAcceleration.y, timeDelta(), world->playerDrag, { -W / 2.0f, -H / 2.0f }, { W / 2.0f, H / 2.0f });
+	if (!world->following.empty())
+		pointTowards(world->following[0]->mover->getPosition());
+}
+
+// where the player disc touches a shape: the direction to push the player out along and how deep it is
+struct Contact {
+	Vector2f normal;
+	float depth;
+};
+
+Vector2f rotateVector(Vector2f v, float degrees) {
+	float c = cos(degrees * PI / 180), s = sin(degrees * PI / 180);
+	return{ v.x * c - v.y * s, v.x * s + v.y * c };
+}
+
+// closest point on the outline of an axis aligned ellipse, a few fixed iterations of the
+// curvature based search are enough to get well below a pixel
+Vector2f closestOnEllipse(Vector2f p, float a, float b) {
+	float px = fabsf(p.x), py = fabsf(p.y);
+	float tx = 0.70710678f, ty = 0.70710678f;
+	for (int i = 0; i < 3; i++) {
+		float x = a * tx, y = b * ty;
+		float ex = (a * a - b * b) * tx * tx * tx / a;
+		float ey = (b * b - a * a) * ty * ty * ty / b;
+		float rx = x - ex, ry = y - ey;
+		float qx = px - ex, qy = py - ey;
+		float r = hypotf(rx, ry), q = std::max(hypotf(qx, qy), 1e-6f);
+		tx = std::min(std::max((qx * r / q + ex) / a, 0.0f), 1.0f);
+		ty = std::min(std::max((qy * r / q + ey) / b, 0.0f), 1.0f);
+		float t = std::max(hypotf(tx, ty), 1e-6f);
+		tx /= t;
+		ty /= t;
+	}
+	return{ copysignf(a * tx, p.x), copysignf(b * ty, p.y) };
+}
+
+// the ellipse is treated as solid, the wobble of the shift function is left out
+bool collide(const Circle &circle, Vector2f pos, float angle, float scale, Vector2f center, float radius, Contact &contact) {
+	float a = circle.radius.x * scale, b = circle.radius.y * scale;
+	if (a <= 0 || b <= 0) return false;
+	Vector2f local = rotateVector({ center.x - pos.x, center.y - pos.y }, -angle);
+	Vector2f closest = closestOnEllipse(local, a, b);
+	Vector2f offset = { local.x - closest.x, local.y - closest.y };
+	float d = sqrt(offset.x * offset.x + offset.y * offset.y);
+	bool inside = (local.x * local.x) / (a * a) + (local.y * local.y) / (b * b) < 1;
+	if (!inside && d >= radius) return false;
+	Vector2f normal;
+	if (d > 1e-6f) normal = inside ? Vector2f{ -offset.x / d, -offset.y / d } : Vector2f{ offset.x / d, offset.y / d };
+	else normal = { local.x / a, local.y / b }; // right on the outline, push out along the radius
+	float length = sqrt(normal.x * normal.x + normal.y * normal.y);
+	if (length < 1e-6f) normal = { 0, 1 };
+	else normal = { normal.x / length, normal.y / length };
+	contact.normal = rotateVector(normal, angle);
+	contact.depth = inside ? radius + d : radius - d;
+	return true;
+}
+
+Vector2f closestOnSegment(Vector2f p, Vector2f a, Vector2f b) {
+	Vector2f ab = { b.x - a.x, b.y - a.y };
+	float lengthSquared = ab.x * ab.x + ab.y * ab.y;
+	float t = lengthSquared > 0 ? ((p.x - a.x) * ab.x + (p.y - a.y) * ab.y) / lengthSquared : 0;
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	return{ a.x + ab.x * t, a.y + ab.y * t };
+}
+
+bool collide(const Triangle &triangle, Vector2f pos, float angle, float scale, Vector2f center, float radius, Contact &contact) {
+	// the same transform drawShape applies, in world space
+	Vector2f pivot = triangle.middle ? triangle.center : Vector2f{ 0, 0 };
+	Vector2f v[3];
+	for (int i = 0; i < 3; i++) {
+		Vector2f p = rotateVector({ (triangle.points[i].x - pivot.x) * scale, (triangle.points[i].y - pivot.y) * scale }, angle);
+		v[i] = { pos.x + p.x, pos.y + p.y };
+	}
+	Vector2f closest = v[0];
+	float closestDistance = -1;
+	int positive = 0, negative = 0;
+	for (int i = 0; i < 3; i++) {
+		Vector2f a = v[i], b = v[(i + 1) % 3];
+		float cross = (b.x - a.x) * (center.y - a.y) - (b.y - a.y) * (center.x - a.x);
+		if (cross > 0) positive++;
+		if (cross < 0) negative++;
+		Vector2f c = closestOnSegment(center, a, b);
+		float d = sqrDistance(c, center);
+		if (closestDistance < 0 || d < closestDistance) {
+			closestDistance = d;
+			closest = c;
+		}
+	}
+	bool inside = positive == 0 || negative == 0;
+	float d = sqrt(closestDistance);
+	if (!inside && d >= radius) return false;
+	if (d < 1e-6f) {
+		// degenerate, push away from the triangle's pivot
+		Vector2f away = { center.x - pos.x, center.y - pos.y };
+		float length = sqrt(away.x * away.x + away.y * away.y);
+		contact.normal = length > 1e-6f ? Vector2f{ away.x / length, away.y / length } : Vector2f{ 0, 1 };
+	}
+	else if (inside)
+		contact.normal = { (closest.x - center.x) / d, (closest.y - center.y) / d };
+	else
+		contact.normal = { (center.x - closest.x) / d, (center.y - closest.y) / d };
+	contact.depth = inside ? radius + d : radius - d;
+	return true;
+}
+
+// shapes are not moved by the player, so all of the response goes into the player. the push is
+// kept inside the window like the integration step is, a shape on the edge cannot shove the player out
+void applyContact(const Contact &contact) {
+	world->playerPosition.x = std::min(std::max(world->playerPosition.x + contact.normal.x * contact.depth, -W / 2.0f), W / 2.0f);
+	world->playerPosition.y = std::min(std::max(world->playerPosition.y + contact.normal.y * contact.depth, -H / 2.0f), H / 2.0f);
+	float normalSpeed = world->playerVelocity.x * contact.normal.x + world->playerVelocity.y * contact.normal.y;
+	if (normalSpeed < 0) {
+		float impulse = -(1 + PLAYER_RESTITUTION) * normalSpeed;
+		world->playerVelocity.x += impulse * contact.normal.x;
+		world->playerVelocity.y += impulse * contact.normal.y;
+	}
+}
+
+// the grid finds the shapes near the player, each candidate is then tested against its real outline
+template <typename Shape>
+void collidePlayer(ShapeStore<Shape> &store, std::vector<int> &candidates) {
+	{
+		ProfileScope scope(PHASE_COLLISION_BROADPHASE);
+		candidates.clear();
+		store.queryRange(world->playerPosition, PLAYER_RADIUS, [&candidates](int i) { candidates.push_back(i); });
+	}
+	ProfileScope scope(PHASE_COLLISION_NARROWPHASE);
+	for (size_t c = 0; c < candidates.size(); c++) {
+		int i = candidates[c];
+		Contact contact;
+		if (collide(store.shapes[i], store.pos[i], store.angle[i], store.scale[i], world->playerPosition, PLAYER_RADIUS, contact))
+			applyContact(contact);
+	}
+}
+
+void collidePlayer() {
+	static thread_local std::vector<int> candidates; // reused so steady frames do not allocate
+	collidePlayer(world->circles, candidates);
+	collidePlayer(world->triangles, candidates);
+}
+
+// advances the whole scene by one fixed step, the result only depends on the inputs, never on the frame rate
+void simulate() {
+	world->timeDelta = FIXED_TIME_STEP;
+	world->time += FIXED_TIME_STEP;
+	world->steps++;
+	world->previousPlayerPosition = world->playerPosition;
+	float t = time(), dt = timeDelta();
+	{
+		ProfileScope scope(PHASE_UPDATE_BEHAVIORS);
+		std::vector<IUpdateBehavior*> &updateBehaviors = world->updateBehaviors;
+		jobs.parallelFor((int)updateBehaviors.size(), 16, [&updateBehaviors, t, dt](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				if (!updateBehaviors[i]->isSerial())
+					updateBehaviors[i]->update(t, dt);
+		});
+		for (size_t i = 0; i < updateBehaviors.size(); i++)
+		{
+			if (updateBehaviors[i]->isSerial())
+				updateBehaviors[i]->update(t, dt);
+		}
+	}
+	{
+		ProfileScope scope(PHASE_BEFORE_REDISPLAY);
+		beforeRedisplay();
+	}
+	collidePlayer();
+}
+
+void replayDueEvents();
+
+// runs as many fixed steps as fit into the real time that passed, the remainder carries over to the next frame
+// and decides how far between the last two steps the frame is drawn
+void advance(duration<double> elapsed) {
+	world->accumulator += std::min(elapsed, MAX_FRAME_TIME);
+	while (world->accumulator >= FIXED_TIME_STEP) {
+		replayDueEvents();
+		simulate();
+		world->accumulator -= FIXED_TIME_STEP;
+	}
+	world->renderAlpha = (float)(world->accumulator / FIXED_TIME_STEP);
+}
+
+void update() {
+	static int framesDrawn = 0;
+	static int lastTime = 0;
+	static uint64_t lastAllocations = 0;
+	// sleep until the next frame is due instead of spinning a core at 100%
+	if (FRAME_RATE_CAP > 0) {
+		steady_clock::duration frameTime = duration_cast<steady_clock::duration>(duration<double>(1 / FRAME_RATE_CAP));
+		time_point<steady_clock> now = steady_clock::now();
+		if (now < NEXT_FRAME_TIME)
+			std::this_thread::sleep_until(NEXT_FRAME_TIME);
+		// when a frame runs late, start counting again from now rather than rushing to catch up
+		NEXT_FRAME_TIME = std::max(NEXT_FRAME_TIME + frameTime, now);
+	}
+	PREVIOUS_TIME = CURRENT_TIME;
+	CURRENT_TIME = steady_clock::now();
+	duration<double> sinceStart = CURRENT_TIME - START_TIME;
+	if ((int)sinceStart.count() > lastTime) {
+		lastTime = (int)sinceStart.count();
+		std::cout << "Average FPS: " << (float)framesDrawn / lastTime << std::endl;
+		std::cout << "Heap allocations in the last second: " << heapAllocations - lastAllocations << std::endl;
+		lastAllocations = heapAllocations;
+		profiler.report((size_t)std::max(FRAME_RATE_CAP, 60.0)); // about the last second
+	}
+	profiler.beginFrame();
+	advance(CURRENT_TIME - PREVIOUS_TIME);
+	glutPostRedisplay();
+	framesDrawn++;
+}
+
+void reshape(int w, int h) {
+	std::cout << "Please don't reshape my fragile window!" << std::endl;
+	glutReshapeWindow(W, H);
+}
+
+void passiveMotion(int x, int y) {
+}
+
+void keyboard(unsigned char c, int x, int y) {
+	if (c == 'a') {
+		world->playerAcceleration.x = -PLAYER_ACCELERATION;
+	}
+	else if (c == 'd') {
+		world->playerAcceleration.x = PLAYER_ACCELERATION;
+	}
+	else if (c == 'w') {
+		world->playerAcceleration.y = PLAYER_ACCELERATION - world->gravity;
+	}
+	else if (c == 's') {
+		world->playerAcceleration.y = -PLAYER_ACCELERATION - world->gravity;
+	}
+	else if (c == 'e') {
+		world->particles.burst(world->playerPosition, 5000, 900);
+	}
+	else if (c == '[' || c == ']') {
+		LOD_QUALITY = c == ']' ? LOD_QUALITY * 2 : LOD_QUALITY / 2;
+		std::cout << "Level of detail quality: " << LOD_QUALITY << std::endl;
+	}
+	else if (c == 'p') {
+		if (profiler.writeChromeTrace("frame_trace.json"))
+			std::cout << "Frame trace written to frame_trace.json" << std::endl;
+	}
+}
+
+void keyboardUp(unsigned char c, int x, int y) {
+	if (c == 'a') {
+		world->playerAcceleration.x += PLAYER_ACCELERATION;
+	}
+	else if (c == 'd') {
+		world->playerAcceleration.x -= PLAYER_ACCELERATION;
+	}
+	else if (c == 'w') {
+		world->playerAcceleration.y -= PLAYER_ACCELERATION;
+	}
+	else if (c == 's') {
+		world->playerAcceleration.y += PLAYER_ACCELERATION;
+	}
+}
+
+void mainMenu(int val) {
+	if (val == 0) {
+		for (int i = 0; i < world->mainWave.size(); i++)
+			world->mainWave[i]->shiftRate *= -1;
+	}
+	else if (val == 1) {
+		for (int i = 0; i < world->mainTree.size(); i++)
+			world->mainTree[i]->toggleSplitAngleDance();
+	}
+	else if (val == 2) {
+		for (int i = 0; i < world->mainTree.size(); i++)
+			world->mainTree[i]->toggleDepthDance();
+	}
+	else if (val == 3) {
+		for (int i = 0; i < world->mainTree.size(); i++)
+			world->mainTree[i]->toggleLengthDance();
+	}
+	else if (val == 4) {
+		for (int i = 0; i < world->mainTree.size(); i++) {
+			world->mainTree[i]->toggleRandomness();
+			world->mainTree[i]->tree->state = world->random();
+		}
+	}
+	else if (val == 5) {
+		for (int i = 0; i < world->following.size(); i++)
+			world->following[i]->toggleRunningState();
+		if (!world->following.empty() && world->trackingLine)
+			world->trackingLine->tracking = world->following[0]->running;
+	}
+	else if (val == 6) {
+		for (int i = 0; i < world->following.size(); i++)
+			world->following[i]->toggleDirection();
+	}
+	else if (val == 7) {
+		world->clicked.removeAll();
+	}
+}
+
+// every key, click and menu choice can be written down together with the number of simulation steps taken
+// before it arrived. the steps only depend on their inputs, so handing the same events to the same steps of
+// a scene built from the same seed plays the session back exactly, without a window and as fast as it draws
+const char EVENT_LOG_MAGIC[4] = { 'E', 'V', 'T', '1' };
+
+struct EventLogHeader {
+	char magic[4]; // EVENT_LOG_MAGIC
+	uint32_t seed; // the world was seeded with it before the scene was built
+};
+
+enum InputEventType { EVENT_KEY_DOWN, EVENT_KEY_UP, EVENT_CLICK, EVENT_MENU, EVENT_END };
+
+// the events follow the header up to the end of the file, oldest first
+struct InputEvent {
+	uint32_t step; // the steps its world had taken when it arrived
+	uint8_t type;
+	uint8_t code; // the key, mouse button or menu entry
+	uint8_t state; // of the mouse button
+	uint8_t unused;
+	int16_t x, y; // the mouse, in window coordinates
+};
+
+std::ofstream eventLog; // open while recording
+std::vector<InputEvent> replayEvents;
+
+void recordEvent(InputEventType type, int code, int state, int x, int y) {
+	if (!eventLog.is_open()) return;
+	InputEvent e = { world->steps, (uint8_t)type, (uint8_t)code, (uint8_t)state, 0, (int16_t)x, (int16_t)y };
+	eventLog.write((const char*)&e, sizeof(e));
+	eventLog.flush(); // only a few a second, and a crash keeps what led up to it
+}
+
+// closing the window exits the program from inside GLUT, so the end of the session is noted on the way out
+void finishRecording() {
+	recordEvent(EVENT_END, 0, 0, 0, 0);
+	eventLog.close();
+}
+
+bool startRecording(const char *path, unsigned int seed) {
+	eventLog.open(path, std::ios::binary);
+	EventLogHeader header;
+	memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+	header.seed = seed;
+	eventLog.write((const char*)&header, sizeof(header));
+	if (!eventLog) return false;
+	atexit(finishRecording);
+	return true;
+}
+
+void recordedKeyboard(unsigned char c, int x, int y) {
+	recordEvent(EVENT_KEY_DOWN, c, 0, x, y);
+	keyboard(c, x, y);
+}
+
+void recordedKeyboardUp(unsigned char c, int x, int y) {
+	recordEvent(EVENT_KEY_UP, c, 0, x, y);
+	keyboardUp(c, x, y);
+}
+
+void recordedClick(int btn, int st, int x, int y) {
+	recordEvent(EVENT_CLICK, btn, st, x, y);
+	click(btn, st, x, y);
+}
+
+void recordedMainMenu(int val) {
+	recordEvent(EVENT_MENU, val, 0, 0, 0);
+	mainMenu(val);
+}
+
+void dispatchEvent(const InputEvent &e) {
+	if (e.type == EVENT_KEY_DOWN)
+		keyboard(e.code, e.x, e.y);
+	else if (e.type == EVENT_KEY_UP)
+		keyboardUp(e.code, e.x, e.y);
+	else if (e.type == EVENT_CLICK)
+		click(e.code, e.state, e.x, e.y);
+	else if (e.type == EVENT_MENU)
+		mainMenu(e.code);
+}
+
+// runs before every simulation step, the replayed events arrive just where they did in the session
+void replayDueEvents() {
+	while (world->replayNext < replayEvents.size() && replayEvents[world->replayNext].step <= world->steps)
+		dispatchEvent(replayEvents[world->replayNext++]);
+}
+
+bool loadEventLog(const char *path, unsigned int &seed, std::string &error) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "cannot open the file";
+		return false;
+	}
+	EventLogHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) != 0) {
+		error = "not an event log";
+		return false;
+	}
+	seed = header.seed;
+	replayEvents.clear();
+	world->replayNext = 0;
+	InputEvent e;
+	while (file.read((char*)&e, sizeof(e))) {
+		if (!replayEvents.empty() && e.step < replayEvents.back().step) {
+			error = "events out of order";
+			return false;
+		}
+		replayEvents.push_back(e);
+	}
+	if (file.gcount() != 0) {
+		error = "truncated event";
+		return false;
+	}
+	return true;
+}
+
+void genWave(Vector2f p) {
+	SineWave *sineWave = world->wavePool.spawn();
+	sineWave->pos = p;
+	sineWave->length = 200 + world->random() % 100;
+	sineWave->amplitude = 20 + world->random() % 10;
+	sineWave->frequency = 0.15 + 0.10 * (world->random() % 31) / 30.0;
+	sineWave->color = getRandomColor();
+	world->drawables.push_back(sineWave);
+	SineWaveBehavior *sineBehavior = world->waveBehaviorPool.spawn(sineWave);
+	sineBehavior->shiftRate = 30 + world->random() % 30;
+	if (world->random() % 2) sineBehavior->shiftRate *= -1;
+	world->updateBehaviors.push_back(sineBehavior);
+	world->mainWave.push_back(sineBehavior);
+}
+
+void genTree(Vector2f p, int length = 70, int lengthDance = 35, int depth = 9, int startAngle = 0,
+	float splitAngleDance = 24, float splitAngleDanceFreq = 0.8, float depthDanceFreq = 0.2,
+	float lengthDanceFreq = 0.3, int depthDance = 4, float splitAngle = 40, float splitSizeFactor = 0.8) {
+	Tree *tree = world->treePool.spawn();
+	tree->pos = p;
+	tree->startAngle = startAngle;
+	tree->splitAngle = splitAngle;
+	tree->depth = std::min(std::max(depth, 0), TREE_MAX_DEPTH);
+	tree->length = length;
+	tree->splitSizeFactor = splitSizeFactor;
+	world->drawables.push_back(tree);
+	world->trees.push_back(tree);
+	TreeBehavior *tb = world->treeBehaviorPool.spawn(tree);
+	tb->splitAngleDance = splitAngleDance;
+	tb->splitAngleDanceFreq = splitAngleDanceFreq;
+	tb->depthDance = depthDance;
+	tb->depthDanceFreq = depthDanceFreq;
+	tb->lengthDance = lengthDance;
+	tb->lengthDanceFreq = lengthDanceFreq;
+	world->updateBehaviors.push_back(tb);
+	world->mainTree.push_back(tb);
+}
+
+// the circle starts index samples into the recording and takes as long for a lap as
+// it took when the movers still stepped from sample to sample every 0.1 seconds
+PathFollowingBehavior* genMovingCircle(const Path *path, int rounds, int index, Vector3f color, float radius) {
+	PathFollowingBehavior *following = world->followerPool.spawn();
+	following->path = path;
+	float lapTime = path->rawCount * 0.1f;
+	following->speed = path->length() / lapTime;
+	following->offset = path->length() * index / std::max(path->rawCount, (size_t)1);
+	EntityHandle handle = genCircle(path->at(following->offset));
+	Circle &circle = world->circles.shapes[world->circles.indexOf(handle)];
+	circle.shiftFunc = NULL;
+	circle.radius = { radius, radius };
+	circle.color = color;
+	circle.rounds = rounds;
+	following->mover = world->circleMoverPool.spawn(&world->circles, handle);
+	world->updateBehaviors.push_back(following);
+	world->following.push_back(following);
+	return following;
+}
+void initializeScene();
+
+void initialize() {
+	glutDisplayFunc(display);
+	glutIdleFunc(update);
+	glutMouseFunc(recordedClick);
+	glutReshapeFunc(reshape);
+	glutPassiveMotionFunc(passiveMotion);
+	glutKeyboardFunc(recordedKeyboard);
+	glutKeyboardUpFunc(recordedKeyboardUp);
+
+	std::cout << "=== INSTRUCTIONS ===" << std::endl;
+	std::cout << "Move the player using WASD key" << std::endl;
+	std::cout << "Right-click to open menu" << std::endl;
+	std::cout << "Left-click to spawn new random object" << std::endl;
+	std::cout << "Press E to throw particles from the player" << std::endl;
+	std::cout << "Press [ and ] to lower and raise the level of detail" << std::endl;
+	std::cout << "Press P to save a frame trace for chrome://tracing" << std::endl;
+	std::cout << std::endl;
+	std::cout << "=== LOGS ===" << std::endl;
+	glutCreateMenu(recordedMainMenu);
+	glutAddMenuEntry("Toggle Tree Split Angle Dance", 1);
+	glutAddMenuEntry("Toggle Tree Depth Dance", 2);
+	glutAddMenuEntry("Toggle Tree Length Dance", 3);
+	glutAddMenuEntry("Toggle Tree Symmetry/Asymmetry", 4);
+	glutAddMenuEntry("Toggle Mover Running State", 5);
+	glutAddMenuEntry("Toggle Mover Direction", 6);
+	glutAddMenuEntry("Toggle Wave Direction", 0);
+	glutAddMenuEntry("Clear Spawned Objects", 7);
+	glutAttachMenu(GLUT_RIGHT_BUTTON);
+	initializeScene();
+	START_TIME = steady_clock::now();
+	CURRENT_TIME = START_TIME;
+	NEXT_FRAME_TIME = START_TIME;
+}
+
+// the binary scene file is a header followed by each kind of record back to back, in the order of the
+// header's counts. every field is 4 bytes so a mapped file can be read in place, the text form is
+// parsed into the same records
+struct SceneHeader {
+	char magic[4]; // SCENE_MAGIC
+	uint32_t treeCount;
+	uint32_t waveCount;
+	uint32_t emitterCount;
+	uint32_t pathCount;
+	uint32_t pointCount; // of all paths together
+	uint32_t tracking; // whether the player is tied to the first mover
+};
+
+// every parameter of genTree, in its order
+struct TreeRecord {
+	Vector2f pos;
+	float length = 70, lengthDance = 35, depth = 9, startAngle = 0;
+	float splitAngleDance = 24, splitAngleDanceFreq = 0.8f, depthDanceFreq = 0.2f;
+	float lengthDanceFreq = 0.3f, depthDance = 4, splitAngle = 40, splitSizeFactor = 0.8f;
+};
+
+struct WaveRecord {
+	Vector2f pos;
+};
+
+enum EmitterKind {
+	EMIT_CIRCLES,
+	EMIT_TRIANGLES
+};
+
+// count random shapes spawned at pos
+struct EmitterRecord {
+	uint32_t kind = EMIT_CIRCLES;
+	Vector2f pos;
+	uint32_t count = 0;
+};
+
+// points [firstPoint, firstPoint + pointCount) of the point array, with moverCount circles running along it
+struct PathRecord {
+	uint32_t firstPoint = 0;
+	uint32_t pointCount = 0;
+	uint32_t moverCount = 0;
+};
+
+const char SCENE_MAGIC[4] = { 'S', 'C', 'N', '1' };
+const char *SCENE_PATH = "default.scene";
+const uint32_t SCENE_MAX_COUNT = 1 << 20; // shapes an emitter spawns or movers a path carries
+const float SCENE_MAX_NUMBER = 1e9f; // every number of a scene fits an int, some of them are cast to one
+const int SCENE_MAX_EXPONENT = 1000; // of a number in the text form, keeps the exponent inside an int
+
+// false for infinities and nan too
+bool sceneNumberInRange(float value) {
+	return fabsf(value) <= SCENE_MAX_NUMBER;
+}
+
+// empty when buildScene can spawn the tree, otherwise what is wrong with it
+std::string treeRecordError(const TreeRecord &tree) {
+	const float values[] = { tree.pos.x, tree.pos.y, tree.length, tree.lengthDance, tree.depth, tree.startAngle, tree.splitAngleDance,
+		tree.splitAngleDanceFreq, tree.depthDanceFreq, tree.lengthDanceFreq, tree.depthDance, tree.splitAngle, tree.splitSizeFactor };
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+		if (!sceneNumberInRange(values[i])) return "tree value out of range";
+	if (tree.depth < 0 || tree.depth > TREE_MAX_DEPTH || tree.depthDance < 0 || tree.depthDance > TREE_MAX_DEPTH)
+		return "tree depth and depth dance must be between 0 and " + std::to_string(TREE_MAX_DEPTH);
+	return std::string();
+}
+
+// where the records of a scene are, either inside a mapped binary file or in the vectors of a parsed text file
+struct SceneView {
+	SceneHeader header = SceneHeader();
+	const TreeRecord *trees = NULL;
+	const WaveRecord *waves = NULL;
+	const EmitterRecord *emitters = NULL;
+	const PathRecord *paths = NULL;
+	const Vector2f *points = NULL;
+};
+
+// a scene as the text form describes it
+struct SceneText {
+	std::vector<TreeRecord> trees;
+	std::vector<WaveRecord> waves;
+	std::vector<EmitterRecord> emitters;
+	std::vector<PathRecord> paths;
+	std::vector<Vector2f> points;
+	bool tracking = false;
+	SceneView view() const {
+		SceneView scene;
+		memcpy(scene.header.magic, SCENE_MAGIC, 4);
+		scene.header.treeCount = (uint32_t)trees.size();
+		scene.header.waveCount = (uint32_t)waves.size();
+		scene.header.emitterCount = (uint32_t)emitters.size();
+		scene.header.pathCount = (uint32_t)paths.size();
+		scene.header.pointCount = (uint32_t)points.size();
+		scene.header.tracking = tracking;
+		scene.trees = trees.empty() ? NULL : &trees[0];
+		scene.waves = waves.empty() ? NULL : &waves[0];
+		scene.emitters = emitters.empty() ? NULL : &emitters[0];
+		scene.paths = paths.empty() ? NULL : &paths[0];
+		scene.points = points.empty() ? NULL : &points[0];
+		return scene;
+	}
+};
+
+// a whole file mapped read only into memory, nothing is copied until the pages are touched
+struct MappedFile {
+	const char *data = NULL;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int file = -1;
+#endif
+	~MappedFile() {
+		close();
+	}
+	bool open(const char *path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) return false;
+		size = (size_t)fileSize.QuadPart;
+		if (size == 0) return true;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) return false;
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		file = ::open(path, O_RDONLY);
+		if (file < 0) return false;
+		struct stat info;
+		if (fstat(file, &info) != 0) return false;
+		size = (size_t)info.st_size;
+		if (size == 0) return true;
+		void *memory = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (memory == MAP_FAILED) return false;
+		data = (const char*)memory;
+#endif
+		return data != NULL;
+	}
+	void close() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data) munmap((void*)data, size);
+		if (file >= 0) ::close(file);
+		file = -1;
+#endif
+		data = NULL;
+		size = 0;
+	}
+};
+
+// reads the text form straight out of a buffer that does not have to end with a zero
+struct SceneParser {
+	const char *at;
+	const char *end;
+	int line = 1;
+	std::string error;
+
+	void skipSpace() {
+		while (at < end) {
+			if (*at == '#')
+				while (at < end && *at != '\n') at++;
+			else if (*at == '\n') {
+				line++;
+				at++;
+			}
+			else if (isspace((unsigned char)*at))
+				at++;
+			else
+				break;
+		}
+	}
+	// true when another value follows on the same line
+	bool moreOnLine() {
+		while (at < end && (*at == ' ' || *at == '\t' || *at == '\r')) at++;
+		return at < end && *at != '\n' && *at != '#';
+	}
+	std::string word() {
+		skipSpace();
+		const char *start = at;
+		while (at < end && !isspace((unsigned char)*at)) at++;
+		return std::string(start, at);
+	}
+	bool number(float &value) {
+		skipSpace();
+		const char *start = at;
+		bool negative = false;
+		if (at < end && (*at == '-' || *at == '+')) negative = *at++ == '-';
+		double result = 0;
+		bool digits = false;
+		while (at < end && isdigit((unsigned char)*at)) {
+			result = result * 10 + (*at++ - '0');
+			digits = true;
+		}
+		if (at < end && *at == '.') {
+			at++;
+			double place = 0.1;
+			while (at < end && isdigit((unsigned char)*at)) {
+				result += (*at++ - '0') * place;
+				place *= 0.1;
+				digits = true;
+			}
+		}
+		if (digits && at < end && (*at == 'e' || *at == 'E')) {
+			at++;
+			bool negativeExponent = false;
+			if (at < end && (*at == '-' || *at == '+')) negativeExponent = *at++ == '-';
+			int exponent = 0;
+			while (at < end && isdigit((unsigned char)*at)) {
+				// past SCENE_MAX_EXPONENT the digits are only skipped, the number is rejected below
+				if (exponent <= SCENE_MAX_EXPONENT) exponent = exponent * 10 + (*at - '0');
+				at++;
+			}
+			if (exponent > SCENE_MAX_EXPONENT) {
+				at = start;
+				return fail("number out of range");
+			}
+			result *= pow(10.0, negativeExponent ? -exponent : exponent);
+		}
+		if (!digits || (at < end && !isspace((unsigned char)*at))) {
+			at = start;
+			return fail("expected a number");
+		}
+		if (!(result <= SCENE_MAX_NUMBER)) {
+			at = start;
+			return fail("number out of range");
+		}
+		value = (float)(negative ? -result : result);
+		return true;
+	}
+	// a whole number without a sign, up to max
+	bool count(uint32_t &value, uint32_t max) {
+		skipSpace();
+		const char *start = at;
+		uint64_t result = 0;
+		bool digits = false;
+		while (at < end && isdigit((unsigned char)*at) && result <= max) {
+			result = result * 10 + (*at++ - '0');
+			digits = true;
+		}
+		if (digits && result > max) {
+			at = start;
+			return fail(("count above " + std::to_string(max)).c_str());
+		}
+		if (!digits || (at < end && !isspace((unsigned char)*at))) {
+			at = start;
+			return fail("expected a count");
+		}
+		value = (uint32_t)result;
+		return true;
+	}
+	bool fail(const char *message) {
+		if (error.empty()) error = "line " + std::to_string(line) + ": " + message;
+		return false;
+	}
+
+	bool parse(SceneText &scene) {
+		for (skipSpace(); at < end; skipSpace()) {
+			std::string command = word();
+			if (command == "tree") {
+				TreeRecord tree;
+				float *optional[] = { &tree.length, &tree.lengthDance, &tree.depth, &tree.startAngle, &tree.splitAngleDance,
+					&tree.splitAngleDanceFreq, &tree.depthDanceFreq, &tree.lengthDanceFreq, &tree.depthDance, &tree.splitAngle, &tree.splitSizeFactor };
+				if (!number(tree.pos.x) || !number(tree.pos.y)) return false;
+				for (int i = 0; i < 11 && moreOnLine(); i++)
+					if (!number(*optional[i])) return false;
+				std::string treeError = treeRecordError(tree);
+				if (!treeError.empty()) return fail(treeError.c_str());
+				scene.trees.push_back(tree);
+			}
+			else if (command == "wave") {
+				WaveRecord wave;
+				if (!number(wave.pos.x) || !number(wave.pos.y)) return false;
+				scene.waves.push_back(wave);
+			}
+			else if (command == "circles" || command == "triangles") {
+				EmitterRecord emitter;
+				emitter.kind = command == "circles" ? EMIT_CIRCLES : EMIT_TRIANGLES;
+				if (!number(emitter.pos.x) || !number(emitter.pos.y) || !count(emitter.count, SCENE_MAX_COUNT)) return false;
+				scene.emitters.push_back(emitter);
+			}
+			else if (command == "path") {
+				PathRecord path;
+				path.firstPoint = (uint32_t)scene.points.size();
+				if (!count(path.moverCount, SCENE_MAX_COUNT) || !count(path.pointCount, UINT32_MAX)) return false;
+				// every point takes at least two digits and two spaces, so the rest of the file bounds what to reserve
+				if (path.pointCount > (uint64_t)(end - at) / 4) return fail("the path has more points than the file holds");
+				scene.points.reserve(scene.points.size() + path.pointCount);
+				for (uint32_t i = 0; i < path.pointCount; i++) {
+					Vector2f p;
+					if (!number(p.x) || !number(p.y)) return false;
+					scene.points.push_back(p);
+				}
+				scene.paths.push_back(path);
+			}
+			else if (command == "tracking")
+				scene.tracking = true;
+			else
+				return fail(("unknown command " + command).c_str());
+		}
+		return true;
+	}
+};
 
-	glBegin(glPrimitive);
-	for (int i = 0; i < rounds; i++) {
-		float theta = i * factor;
-		float shift = shiftFunc ? shiftFunc(theta) : 0;
-		float shiftX = cos(theta) * shift;
-		float shiftY = sin(theta) * shift;
-		glVertex2f(radius.x*cosf(theta) + shiftX, radius.y*sinf(theta) + shiftY);
+// points the view into a mapped binary file after checking the counts fit the file and the records can be built
+bool viewBinaryScene(const char *data, size_t size, SceneView &scene) {
+	if (size < sizeof(SceneHeader)) return false;
+	memcpy(&scene.header, data, sizeof(SceneHeader));
+	const SceneHeader &h = scene.header;
+	uint64_t needed = sizeof(SceneHeader) + (uint64_t)h.treeCount * sizeof(TreeRecord) + (uint64_t)h.waveCount * sizeof(WaveRecord)
+		+ (uint64_t)h.emitterCount * sizeof(EmitterRecord) + (uint64_t)h.pathCount * sizeof(PathRecord) + (uint64_t)h.pointCount * sizeof(Vector2f);
+	if (needed > size) return false;
+	const char *at = data + sizeof(SceneHeader);
+	scene.trees = (const TreeRecord*)at;
+	at += h.treeCount * sizeof(TreeRecord);
+	scene.waves = (const WaveRecord*)at;
+	at += h.waveCount * sizeof(WaveRecord);
+	scene.emitters = (const EmitterRecord*)at;
+	at += h.emitterCount * sizeof(EmitterRecord);
+	scene.paths = (const PathRecord*)at;
+	at += h.pathCount * sizeof(PathRecord);
+	scene.points = (const Vector2f*)at;
+	for (uint32_t i = 0; i < h.pathCount; i++)
+		if ((uint64_t)scene.paths[i].firstPoint + scene.paths[i].pointCount > h.pointCount || scene.paths[i].moverCount > SCENE_MAX_COUNT) return false;
+	for (uint32_t i = 0; i < h.pointCount; i++)
+		if (!sceneNumberInRange(scene.points[i].x) || !sceneNumberInRange(scene.points[i].y)) return false;
+	for (uint32_t i = 0; i < h.waveCount; i++)
+		if (!sceneNumberInRange(scene.waves[i].pos.x) || !sceneNumberInRange(scene.waves[i].pos.y)) return false;
+	for (uint32_t i = 0; i < h.emitterCount; i++) {
+		const EmitterRecord &e = scene.emitters[i];
+		if ((e.kind != EMIT_CIRCLES && e.kind != EMIT_TRIANGLES) || e.count > SCENE_MAX_COUNT) return false;
+		if (!sceneNumberInRange(e.pos.x) || !sceneNumberInRange(e.pos.y)) return false;
 	}
-	glEnd();
+	for (uint32_t i = 0; i < h.treeCount; i++)
+		if (!treeRecordError(scene.trees[i]).empty()) return false;
+	return true;
 }
 
-struct IRotateAble {
-	virtual void addAngle(float angle) = 0;
-};
+bool writeBinaryScene(const SceneView &scene, const char *path) {
+	std::ofstream file(path, std::ios::binary);
+	const SceneHeader &h = scene.header;
+	file.write((const char*)&h, sizeof(h));
+	file.write((const char*)scene.trees, h.treeCount * sizeof(TreeRecord));
+	file.write((const char*)scene.waves, h.waveCount * sizeof(WaveRecord));
+	file.write((const char*)scene.emitters, h.emitterCount * sizeof(EmitterRecord));
+	file.write((const char*)scene.paths, h.pathCount * sizeof(PathRecord));
+	file.write((const char*)scene.points, h.pointCount * sizeof(Vector2f));
+	return (bool)file;
+}
 
-struct IScaleAble {
-	virtual void setScale(float scale) = 0;
-};
+// as few digits as read back to the same float, so converting back and forth loses nothing
+std::string sceneNumber(float value) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.6g", value);
+	if (strtof(text, NULL) != value)
+		snprintf(text, sizeof(text), "%.9g", value);
+	return text;
+}
 
-struct Circle : public IDrawable, public IRotateAble, public IScaleAble, public IMover {
-	Vector2f radius;
-	Vector2f pos;
-	float angle;
-	float scale;
-	float(*shiftFunc)(float theta) = NULL;
-	Vector3f color;
-	int rounds = 0;
-	void draw() {
-		glPushMatrix();
-		glTranslatef(pos.x, pos.y, 0);
-		glRotatef(angle, 0, 0, 1);
-		glScalef(scale, scale, scale);
-		glColor3f(color.x, color.y, color.z);
-		drawCircle(GL_LINE_LOOP, radius, shiftFunc, rounds);
-		glPopMatrix();
+bool writeTextScene(const SceneView &scene, const char *path) {
+	std::ofstream file(path);
+	const SceneHeader &h = scene.header;
+	for (uint32_t i = 0; i < h.treeCount; i++) {
+		const TreeRecord &t = scene.trees[i];
+		const float values[] = { t.pos.x, t.pos.y, t.length, t.lengthDance, t.depth, t.startAngle, t.splitAngleDance,
+			t.splitAngleDanceFreq, t.depthDanceFreq, t.lengthDanceFreq, t.depthDance, t.splitAngle, t.splitSizeFactor };
+		file << "tree";
+		for (int j = 0; j < 13; j++)
+			file << " " << sceneNumber(values[j]);
+		file << "\n";
 	}
-	void addAngle(float angle) {
-		this->angle += angle;
+	for (uint32_t i = 0; i < h.waveCount; i++)
+		file << "wave " << sceneNumber(scene.waves[i].pos.x) << " " << sceneNumber(scene.waves[i].pos.y) << "\n";
+	for (uint32_t i = 0; i < h.emitterCount; i++) {
+		const EmitterRecord &e = scene.emitters[i];
+		file << (e.kind == EMIT_CIRCLES ? "circles " : "triangles ") << sceneNumber(e.pos.x) << " " << sceneNumber(e.pos.y) << " " << e.count << "\n";
 	}
-	void setScale(float scale) {
-		this->scale = scale;
-	}
-	void move(Vector2f position) {
-		pos = position;
+	for (uint32_t i = 0; i < h.pathCount; i++) {
+		const PathRecord &p = scene.paths[i];
+		file << "path " << p.moverCount << " " << p.pointCount;
+		for (uint32_t j = 0; j < p.pointCount; j++) {
+			const Vector2f &point = scene.points[p.firstPoint + j];
+			file << (j % 10 ? " " : "\n") << sceneNumber(point.x) << " " << sceneNumber(point.y);
+		}
+		file << "\n";
 	}
-	Vector2f getPosition() {
-		return pos;
+	if (h.tracking) file << "tracking\n";
+	return (bool)file;
+}
+
+// spawns everything the scene describes, in the order initializeScene always did
+void buildScene(const SceneView &scene, bool quiet = false) {
+	const SceneHeader &h = scene.header;
+	for (uint32_t i = 0; i < h.treeCount; i++) {
+		const TreeRecord &t = scene.trees[i];
+		genTree(t.pos, (int)t.length, (int)t.lengthDance, (int)t.depth, (int)t.startAngle, t.splitAngleDance, t.splitAngleDanceFreq,
+			t.depthDanceFreq, t.lengthDanceFreq, (int)t.depthDance, t.splitAngle, t.splitSizeFactor);
 	}
-};
+	for (uint32_t i = 0; i < h.waveCount; i++)
+		genWave(scene.waves[i].pos);
 
-struct Triangle : public IDrawable, public IRotateAble, public IScaleAble {
-	Vector2f points[3];
-	Vector2f pos;
-	float angle;
-	float scale;
-	Vector3f color[3];
-	Vector2f *center = 0;
-	bool middle; // determine whether you want the triangle's pivot point to be in the middle
-	void draw() {
-		if (center == 0 && middle) {
-			center = new Vector2f;
-			center->x = (points[0].x + points[1].x + points[2].x) / 3.0f;
-			center->y = (points[0].y + points[1].y + points[2].y) / 3.0f;
-		}
-		glPushMatrix();
-		glTranslatef(pos.x, pos.y, 0);
-		glRotatef(angle, 0, 0, 1);
-		glScalef(scale, scale, scale);
-		if (middle)
-			glTranslatef(-center->x, -center->y, 0);
-		glBegin(GL_TRIANGLES);
-		for (int i = 0; i < 3; i++) {
-			glColor3f(color[i].x, color[i].y, color[i].z);
-			glVertex2f(points[i].x, points[i].y);
+	// every circle and triangle is drawn and updated by its store
+	world->drawables.push_back(&world->circles);
+	world->drawables.push_back(&world->triangles);
+	world->drawables.push_back(&world->particles);
+	world->updateBehaviors.push_back(&world->circles);
+	world->updateBehaviors.push_back(&world->triangles);
+	world->updateBehaviors.push_back(&world->particles);
+
+	for (uint32_t i = 0; i < h.emitterCount; i++) {
+		const EmitterRecord &e = scene.emitters[i];
+		for (uint32_t j = 0; j < e.count; j++) {
+			if (e.kind == EMIT_CIRCLES)
+				genCircle(e.pos, 1.0f - 0.2f + 0.4f * (world->random() % 100 / 99.0f));
+			else
+				genTriangle(e.pos);
 		}
-		glEnd();
-		glPopMatrix();
-	}
-	void addAngle(float angle) {
-		this->angle += angle;
 	}
-	void setScale(float scale) {
-		this->scale = scale;
-	}
-};
 
-struct RotateBehavior : public IUpdateBehavior {
-	IRotateAble *rotateAble;
-	float rotateSpeed;
-	void update(float time, float timeDelta) {
-		rotateAble->addAngle(rotateSpeed * timeDelta);
+	for (uint32_t i = 0; i < h.pathCount; i++) {
+		const PathRecord &p = scene.paths[i];
+		Path *path = world->pathPool.spawn(scene.points + p.firstPoint, p.pointCount, 1.0f);
+		if (!quiet)
+			std::cout << "Number of moving positions: " << p.pointCount << ", " << path->points.size() << " after simplifying" << std::endl;
+		// a gradient from blue to red, the first mover is the biggest and smoothest
+		int n = (int)p.moverCount;
+		for (int j = 0; j < n; j++) {
+			float t = n > 1 ? j / (float)(n - 1) : 0;
+			genMovingCircle(path, (n - 1 - j) + 3, n - 1 - j, { 1 - t, 0, t }, 10.0f + (n - 1 - j));
+		}
 	}
-};
 
-struct ScaleBehavior : public IUpdateBehavior {
-	IScaleAble *scaleAble;
-	float scale = 1;
-	float scaleDance;
-	float scaleDanceFreq = 1;
-	void update(float time, float timeDelta) {
-		scaleAble->setScale(scale + scaleDance * sinf(scaleDanceFreq * time));
+	if (h.tracking) {
+		world->trackingLine = world->trackingLinePool.spawn();
+		world->trackingLine->playerPosition = &world->playerPosition;
+		world->trackingLine->playerVelocity = &world->playerVelocity;
+		world->trackingLine->following = &world->following;
+		world->drawables.push_back(world->trackingLine);
+		world->updateBehaviors.push_back(world->trackingLine);
 	}
-};
+	world->drawables.push_back(&world->clicked);
+}
 
-void drawRect(int glPrimitve, float w, float h) {
-	// pivot is at the base
-	glBegin(glPrimitve);
-	glVertex2f(-w / 2.0f, 0);
-	glVertex2f(w / 2.0f, 0);
-	glVertex2f(w / 2.0f, h);
-	glVertex2f(-w / 2.0f, h);
-	glEnd();
+// loads the text or the binary form, whichever the file turns out to be
+bool readScene(const char *path, MappedFile &file, SceneText &text, SceneView &scene, std::string &error) {
+	if (!file.open(path)) {
+		error = "could not open the file";
+		return false;
+	}
+	if (file.size >= 4 && memcmp(file.data, SCENE_MAGIC, 4) == 0) {
+		if (viewBinaryScene(file.data, file.size, scene)) return true;
+		error = "the binary scene is cut short, holds values out of range or an unknown emitter kind";
+		return false;
+	}
+	SceneParser parser;
+	parser.at = file.data;
+	parser.end = file.data + file.size;
+	if (!parser.parse(text)) {
+		error = parser.error;
+		return false;
+	}
+	scene = text.view();
+	return true;
 }
 
-void drawPlayer(float rad, Vector2f gunSize) {
-	glPushMatrix();
-	glTranslatef(playerPosition.x, playerPosition.y, 0);
-	glColor3f(0, 56 / 255.0f, 101 / 255.0f);
-	drawCircle(GL_POLYGON, { rad, rad });
-	glRotatef(playerAngle - 90, 0, 0, 1);
-	drawRect(GL_LINE_LOOP, gunSize.x, gunSize.y);
-	glPopMatrix();
+// the folder the program was started from, with a trailing separator, empty when it cannot be found
+std::string executableDirectory() {
+	char path[4096];
+#ifdef _WIN32
+	DWORD length = GetModuleFileNameA(NULL, path, sizeof(path));
+	if (length == 0 || length == sizeof(path)) return std::string();
+#else
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if (length <= 0 || length == sizeof(path)) return std::string();
+#endif
+	std::string directory(path, length);
+	size_t separator = directory.find_last_of("/\\");
+	return separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
 }
 
-void display() {
-	glClear(GL_COLOR_BUFFER_BIT);
-	glClearColor(14 / 255.0f, 167 / 255.0f, 200 / 255.0f, 1.0f);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	gluOrtho2D(-W / 2, W / 2, -H / 2, H / 2);
+// a relative scene path is looked up in the working directory first and then next to the executable,
+// where the build copies default.scene, so the program finds it whichever folder it is started in
+std::string findScenePath(const char *path) {
+	if (std::ifstream(path)) return path;
+	std::string directory = executableDirectory();
+	bool relative = path[0] != '/' && path[0] != '\\' && !(path[0] && path[1] == ':');
+	if (relative && !directory.empty() && std::ifstream(directory + path)) return directory + path;
+	return path;
+}
 
-	for (size_t i = 0; i < drawables.size(); i++)
-	{
-		setDefaultColor();
-		setDefaultLineWidth();
-		drawables[i]->draw();
+bool loadScene(const char *path) {
+	MappedFile file;
+	SceneText text;
+	SceneView scene;
+	std::string error;
+	if (!readScene(path, file, text, scene, error)) {
+		std::cerr << "Could not load scene " << path << ": " << error << std::endl;
+		return false;
 	}
-	setDefaultColor();
-	setDefaultLineWidth();
-	drawPlayer(25, { 10, 60 });
-	glutSwapBuffers();
+	buildScene(scene);
+	return true;
 }
 
-Vector2f screenToWorld(int x, int y) {
-	float sx = x - W / 2.0f;
-	float sy = (H - y) - H / 2.0f;
-	return{ sx, sy };
+void initializeScene() {
+	// without its scene file the program still runs, with an empty world
+	if (!loadScene(SCENE_PATH))
+		buildScene(SceneView());
 }
 
-Circle* genCircle(Vector2f p, float elipseScale=1.0) {
-	Circle *circle = new Circle;
-	float rad = 30 + rand() % 30;
-	circle->radius = { rad * elipseScale, rad / elipseScale };
-	circle->pos = { p.x, p.y };
-	int ran = rand() % 2;
-	if (ran)
-		circle->shiftFunc = sineShiftFunc;
-	else
-		circle->shiftFunc = analogSineShiftFunc;
-	circle->angle = 0;
-	circle->color = getRandomColor();
-	drawables.push_back(circle);
-	RotateBehavior *rotateBehavior = new RotateBehavior;
-	rotateBehavior->rotateAble = circle;
-	rotateBehavior->rotateSpeed = rand() % 300 - 150;
-	updateBehaviors.push_back(rotateBehavior);
-	ScaleBehavior *scaleBehavior = new ScaleBehavior;
-	scaleBehavior->scaleAble = circle;
-	scaleBehavior->scaleDance = (rand() % 20) / 19.0;
-	updateBehaviors.push_back(scaleBehavior);
-	return circle;
-}
-
-void genTriangle(Vector2f p) {
-	Triangle *triangle = new Triangle;
-	triangle->pos = { p.x, p.y };
-	triangle->angle = 0;
-	for (int i = 0; i < 3; i++) {
-		float rx = 20 + rand() % 50;
-		float ry = 20 + rand() % 50;
-		if (rand() % 2) rx = -rx;
-		if (rand() % 2) ry = -ry;
-		triangle->points[i] = { rx, ry };
-		triangle->color[i] = getRandomColor();
-	}
-	triangle->middle = rand() % 2;
-	drawables.push_back(triangle);
-	RotateBehavior *rotateBehavior = new RotateBehavior;
-	rotateBehavior->rotateAble = triangle;
-	rotateBehavior->rotateSpeed = rand() % 300 - 150;
-	updateBehaviors.push_back(rotateBehavior);
-	ScaleBehavior *scaleBehavior = new ScaleBehavior;
-	scaleBehavior->scaleAble = triangle;
-	scaleBehavior->scaleDance = 0.5 * (rand() % 20) / 19.0;
-	updateBehaviors.push_back(scaleBehavior);
+// removes everything initializeScene and the gen functions created, and rewinds time and the player
+void resetScene() {
+	world->reset();
 }
 
-void click(int btn, int st, int x, int y) {
-	if (st == GLUT_DOWN && btn == GLUT_LEFT_BUTTON) {
-		Vector2f p = screenToWorld(x, y);
-		points.push_back(p);
-		//for (size_t i = 0; i < points.size(); i++)
-		//{
-		//	Vector2f p = points[i];
-		//	cout << "{" << p.x << "," << p.y << "}, ";
-		//}
-		//cout << endl;
-		//cout << "Clicked at: " << p.x << " " << p.y << endl;
-		//Point *apoint = new Point;
-		//apoint->pos = { p.x, p.y };
-		//drawables.push_back(apoint);
+Vector2f randomWorldPosition() {
+	return{ (float)(world->random() % W - W / 2), (float)(world->random() % H - H / 2) };
+}
 
-		//Tree *tree = new Tree;
-		//tree->pos = { p.x, p.y };
-		//tree->startAngle = playerAngle - 90;
-		//tree->length = distance(tree->pos, playerPosition) * 0.3;
-		//tree->depth = 6;
-		//tree->splitAngle = 30;
-		//drawables.push_back(tree);
-		int ran = rand() % 2;
-		if (ran)
-			genCircle(p);
-		else
-			genTriangle(p);
-	}
+void benchCircles(int count) {
+	for (int i = 0; i < count; i++)
+		genCircle(randomWorldPosition(), 1.0f - 0.2f + 0.4f * (world->random() % 100 / 99.0f));
 }
 
-// make player gun points toward the position
-void pointTowards(Vector2f p) {
-	playerAngle = atan2f(p.y - playerPosition.y, p.x - playerPosition.x) * 180 / PI;
+void benchTriangles(int count) {
+	for (int i = 0; i < count; i++)
+		genTriangle(randomWorldPosition());
 }
 
-void beforeRedisplay() {
-	playerVelocity.x += playerAcceleration.x * timeDelta();
-	playerVelocity.y += playerAcceleration.y * timeDelta();
-	playerPosition.x += playerVelocity.x * timeDelta();
-	playerPosition.y += playerVelocity.y * timeDelta();
-	playerVelocity.x *= (1.0f - PLAYER_DRAG);
-	playerVelocity.y *= (1.0f - PLAYER_DRAG);
-	pointTowards(following[0]->mover->getPosition());
-	// prevent player from going out of the boundary
-	if (playerPosition.x < -W / 2.0) playerPosition.x = -W / 2.0;
-	if (playerPosition.x > W / 2.0) playerPosition.x = W / 2.0;
-	if (playerPosition.y < -H / 2.0) playerPosition.y = -H / 2.0;
-	if (playerPosition.y > H / 2.0) playerPosition.y = H / 2.0;
+// one dancing tree, depth stays fixed so every frame generates the same amount of branches
+void benchTree(int depth) {
+	genTree({ 0, -250 }, 70, 35, depth);
+	world->mainTree.back()->toggleSplitAngleDance();
+	world->mainTree.back()->toggleLengthDance();
 }
 
-void update() {
-	static int framesDrawn = 0;
-	static int lastTime = 0;
-	PREVIOUS_TIME = CURRENT_TIME;
-	CURRENT_TIME = system_clock::now();
-	TIME = CURRENT_TIME - START_TIME;
-	TIME_DELTA = CURRENT_TIME - PREVIOUS_TIME;
-	if ((int)time() > lastTime) {
-		lastTime = (int)time();
-		std::cout << "Average FPS: " << (float)framesDrawn / lastTime << std::endl;
+void benchWaves(int length) {
+	for (int i = 0; i < 20; i++) {
+		genWave({ 0, -280 + i * 28.0f });
+		world->mainWave.back()->wave->length = (float)length;
 	}
-	for (size_t i = 0; i < updateBehaviors.size(); i++)
-	{
-		updateBehaviors[i]->update(time(), timeDelta());
+}
+
+// a closed curve that wanders over most of the window
+std::vector<Vector2f> lissajous(int count) {
+	std::vector<Vector2f> points(count);
+	for (int i = 0; i < count; i++) {
+		float t = 2 * PI * i / count;
+		points[i] = { 350 * sinf(3 * t), 250 * sinf(4 * t + 0.5f) };
 	}
-	beforeRedisplay();
-	glutPostRedisplay();
-	framesDrawn++;
+	return points;
 }
 
-void reshape(int w, int h) {
-	std::cout << "Please don't reshape my fragile window!" << std::endl;
-	glutReshapeWindow(W, H);
+void benchFollowers(int count) {
+	std::vector<Vector2f> samples = lissajous(1270);
+	Path *path = world->pathPool.spawn(&samples[0], samples.size(), 1.0f);
+	for (int i = 0; i < count; i++) {
+		PathFollowingBehavior *mover = genMovingCircle(path, 3 + i % 10, (int)(i * samples.size() / count), getRandomColor(), 10.0f + i % 10);
+		mover->toggleRunningState();
+	}
 }
 
-void passiveMotion(int x, int y) {
+void benchParticles(int count) {
+	for (int i = 0; i < count; i += 1000)
+		world->particles.burst(randomWorldPosition(), std::min(1000, count - i), 900);
 }
 
-void keyboard(unsigned char c, int x, int y) {
-	if (c == 'a') {
-		playerAcceleration.x = -PLAYER_ACCELERATION;
+// a scripted scene population, count means whatever build takes: shapes, tree depth or wave length
+struct BenchmarkScenario {
+	const char *name;
+	int count;
+	void(*build)(int count);
+};
+
+// builds every scenario without a window, runs it for a fixed number of frames and prints the results as JSON
+int runBenchmark(int frames, const std::string &backend, const char *outputPath) {
+	SoftwareRenderer softwareRenderer(W, H);
+	NullRenderer nullRenderer;
+	if (backend == "null")
+		useRenderer(&nullRenderer);
+	else if (backend == "software")
+		useRenderer(&softwareRenderer);
+	else {
+		std::cerr << "Unknown backend " << backend << ", use software or null" << std::endl;
+		return 1;
 	}
-	else if (c == 'd') {
-		playerAcceleration.x = PLAYER_ACCELERATION;
+	BenchmarkScenario scenarios[] = {
+		{ "circles", 10000, benchCircles },
+		{ "triangles", 10000, benchTriangles },
+		{ "tree", 6, benchTree },
+		{ "tree", 8, benchTree },
+		{ "tree", 10, benchTree },
+		{ "tree", 12, benchTree },
+		{ "tree", 14, benchTree },
+		{ "waves", 200, benchWaves },
+		{ "waves", 1000, benchWaves },
+		{ "waves", 5000, benchWaves },
+		{ "followers", 1000, benchFollowers },
+		{ "particles", 100000, benchParticles }
+	};
+	const int warmUpFrames = 10;
+	const duration<double> frameTime(1 / 60.0);
+	std::ostringstream json;
+	json << "{\n  \"backend\": \"" << backend << "\",\n  \"threads\": " << jobs.threadCount() << ",\n  \"lodQuality\": " << LOD_QUALITY
+		<< ",\n  \"frames\": " << frames << ",\n  \"scenarios\": [\n";
+	int scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+	for (int s = 0; s < scenarioCount; s++) {
+		std::cerr << "Running " << scenarios[s].name << " " << scenarios[s].count << std::endl;
+		resetScene();
+		world->drawables.push_back(&world->circles);
+		world->drawables.push_back(&world->triangles);
+		world->drawables.push_back(&world->particles);
+		world->updateBehaviors.push_back(&world->circles);
+		world->updateBehaviors.push_back(&world->triangles);
+		world->updateBehaviors.push_back(&world->particles);
+		scenarios[s].build(scenarios[s].count);
+		for (int i = 0; i < warmUpFrames; i++) {
+			advance(frameTime);
+			display();
+		}
+		uint64_t allocationsBefore = heapAllocations;
+		uint64_t verticesBefore = verticesEmitted, culledBefore = itemsCulled, repaintedBefore = pixelsRepainted;
+		uint64_t statesBefore = stateChanges, drawsBefore = drawCalls;
+		time_point<steady_clock> start = steady_clock::now();
+		for (int i = 0; i < frames; i++) {
+			profiler.beginFrame();
+			advance(frameTime);
+			display();
+		}
+		duration<double, std::nano> elapsed = steady_clock::now() - start;
+		uint64_t allocations = heapAllocations - allocationsBefore;
+		uint64_t vertices = verticesEmitted - verticesBefore;
+		uint64_t culled = itemsCulled - culledBefore, repainted = pixelsRepainted - repaintedBefore;
+		uint64_t states = stateChanges - statesBefore, draws = drawCalls - drawsBefore;
+		json << "    { \"name\": \"" << scenarios[s].name << "\", \"count\": " << scenarios[s].count
+			<< ", \"nsPerFrame\": " << (int64_t)(elapsed.count() / std::max(frames, 1))
+			<< ", \"allocationsPerFrame\": " << (double)allocations / std::max(frames, 1)
+			<< ", \"verticesPerFrame\": " << vertices / std::max(frames, 1)
+			<< ", \"culledPerFrame\": " << culled / std::max(frames, 1)
+			<< ", \"repaintedPixelsPerFrame\": " << repainted / std::max(frames, 1)
+			<< ", \"stateChangesPerFrame\": " << states / std::max(frames, 1)
+			<< ", \"drawCallsPerFrame\": " << draws / std::max(frames, 1)
+			<< ", \"rssKb\": " << residentKilobytes() << ", \"processPeakRssKb\": " << peakResidentKilobytes() << " }" << (s + 1 < scenarioCount ? "," : "") << "\n";
 	}
-	else if (c == 'w') {
-		playerAcceleration.y = PLAYER_ACCELERATION - GRAVITY;
+	json << "  ]\n}\n";
+	resetScene();
+	std::cout << json.str();
+	if (outputPath) {
+		std::ofstream file(outputPath);
+		file << json.str();
+		if (!file) {
+			std::cerr << "Could not write " << outputPath << std::endl;
+			return 1;
+		}
 	}
-	else if (c == 's') {
-		playerAcceleration.y = -PLAYER_ACCELERATION - GRAVITY;
+	return 0;
+}
+
+// renders the scene on the CPU without opening a window and reports how long the frames took,
+// every frame advances the simulation by 1/60 second of fixed steps so the same seed draws the same image
+int runHeadless(int frames, const char *imagePath, const char *tracePath) {
+	SoftwareRenderer softwareRenderer(W, H);
+	useRenderer(&softwareRenderer);
+	initializeScene();
+	const duration<double> frameTime(1 / 60.0);
+	time_point<steady_clock> start = steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		profiler.beginFrame();
+		advance(frameTime);
+		display();
+	}
+	duration<double> elapsed = steady_clock::now() - start;
+	std::cout << "Frames drawn: " << softwareRenderer.framesDrawn << std::endl;
+	std::cout << "Average frame time: " << elapsed.count() * 1000 / std::max(frames, 1) << " ms" << std::endl;
+	profiler.report(frames);
+	if (tracePath) {
+		if (!profiler.writeChromeTrace(tracePath)) {
+			std::cerr << "Could not write " << tracePath << std::endl;
+			return 1;
+		}
+		std::cout << "Frame trace written to " << tracePath << std::endl;
+	}
+	if (imagePath) {
+		if (!softwareRenderer.writePPM(imagePath)) {
+			std::cerr << "Could not write " << imagePath << std::endl;
+			return 1;
+		}
+		std::cout << "Last frame written to " << imagePath << std::endl;
 	}
+	return 0;
 }
 
-void keyboardUp(unsigned char c, int x, int y) {
-	if (c == 'a') {
-		playerAcceleration.x += PLAYER_ACCELERATION;
+// plays a recorded session back on the CPU renderer, one frame per simulation step and as fast as they draw,
+// from the seed it was recorded with, so the same log always costs the same work
+int runReplay(const char *logPath, const char *imagePath, const char *tracePath) {
+	unsigned int seed;
+	std::string error;
+	if (!loadEventLog(logPath, seed, error)) {
+		std::cerr << "Could not load event log " << logPath << ": " << error << std::endl;
+		return 1;
 	}
-	else if (c == 'd') {
-		playerAcceleration.x -= PLAYER_ACCELERATION;
+	world->seed(seed);
+	SoftwareRenderer softwareRenderer(W, H);
+	useRenderer(&softwareRenderer);
+	initializeScene();
+	uint32_t lastStep = replayEvents.empty() ? 0 : replayEvents.back().step;
+	time_point<steady_clock> start = steady_clock::now();
+	int frames = 0;
+	for (; world->steps < lastStep; frames++) {
+		profiler.beginFrame();
+		advance(FIXED_TIME_STEP);
+		display();
 	}
-	else if (c == 'w') {
-		playerAcceleration.y -= PLAYER_ACCELERATION;
+	replayDueEvents(); // the ones after the last step
+	duration<double> elapsed = steady_clock::now() - start;
+	std::cout << "Events replayed: " << replayEvents.size() << " over " << world->steps << " steps from seed " << seed << std::endl;
+	std::cout << "Replay time: " << elapsed.count() << " s, " << world->steps * FIXED_TIME_STEP.count() / std::max(elapsed.count(), 1e-9)
+		<< "x real time" << std::endl;
+	std::cout << "Average frame time: " << elapsed.count() * 1000 / std::max(frames, 1) << " ms" << std::endl;
+	std::cout << "Player position: " << world->playerPosition.x << " " << world->playerPosition.y << std::endl;
+	profiler.report(frames);
+	if (tracePath) {
+		if (!profiler.writeChromeTrace(tracePath)) {
+			std::cerr << "Could not write " << tracePath << std::endl;
+			return 1;
+		}
+		std::cout << "Frame trace written to " << tracePath << std::endl;
 	}
-	else if (c == 's') {
-		playerAcceleration.y += PLAYER_ACCELERATION;
+	if (imagePath) {
+		if (!softwareRenderer.writePPM(imagePath)) {
+			std::cerr << "Could not write " << imagePath << std::endl;
+			return 1;
+		}
+		std::cout << "Last frame written to " << imagePath << std::endl;
 	}
+	return 0;
 }
 
-void mainMenu(int val) {
-	if (val == 0) {
-		for (int i = 0; i < mainWave.size(); i++)
-			mainWave[i]->shiftRate *= -1;
+const int EXPORT_POOL_SIZE = 4; // frames in flight between the renderer and the encoder
+
+// a rendered frame on its way to the encoder, its buffers go back to the pool once it is written
+struct ExportFrame {
+	int index;
+	std::vector<uint32_t> pixels;
+	std::vector<uint64_t> tileHashes; // of what pixels holds, so the renderer can keep the tiles that did not change
+};
+
+// writes frames on its own thread while the next ones are rendered. a finished frame is handed over by
+// swapping buffers with the renderer instead of copying, and a buffer is only drawn into again after it was written
+struct FrameEncoder {
+	enum Format { FORMAT_Y4M, FORMAT_PPM, FORMAT_RGBA };
+	Format format;
+	std::string path; // for PPM a pattern with one %d for the frame number, "-" is stdout
+	std::string namePrefix, nameSuffix; // of the PPM pattern, around its %d
+	int numberWidth = 0; // the frame number is padded to at least this many digits
+	bool zeroPadded = false;
+	int width, height, frameRate;
+	std::ostream *out = NULL;
+	std::ofstream file;
+	ExportFrame frames[EXPORT_POOL_SIZE];
+	std::vector<ExportFrame*> freeFrames;
+	std::deque<ExportFrame*> readyFrames; // oldest first
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool finishing = false;
+	bool failed = false;
+	std::thread thread;
+	std::vector<char> converted; // the frame in the output layout, reused for every frame
+	double encodeSeconds = 0;
+	int framesWritten = 0;
+	FrameEncoder(Format format, const std::string &path, int width, int height, int frameRate)
+		: format(format), path(path), width(width), height(height), frameRate(frameRate) {}
+	// picks the format from the file name: .y4m, a pattern with a % for numbered .ppm files, anything else raw RGBA
+	static Format formatOf(const std::string &path) {
+		if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) return FORMAT_Y4M;
+		if (path.find('%') != std::string::npos) return FORMAT_PPM;
+		return FORMAT_RGBA;
 	}
-	else if (val == 1) {
-		for (int i = 0; i < mainTree.size(); i++)
-			mainTree[i]->toggleSplitAngleDance();
+	// splits the PPM pattern around its one %d, which may give a width as in %5d or %05d. the names are
+	// put together by frameName rather than printf, so a stray % in a path can never make it read garbage
+	bool readPattern() {
+		size_t at = path.find('%');
+		if (at == std::string::npos) return false;
+		size_t i = at + 1;
+		zeroPadded = i < path.size() && path[i] == '0';
+		numberWidth = 0;
+		for (; i < path.size() && isdigit((unsigned char)path[i]) && numberWidth < 100; i++)
+			numberWidth = numberWidth * 10 + (path[i] - '0');
+		if (i >= path.size() || path[i] != 'd') return false;
+		namePrefix = path.substr(0, at);
+		nameSuffix = path.substr(i + 1);
+		return nameSuffix.find('%') == std::string::npos;
 	}
-	else if (val == 2) {
-		for (int i = 0; i < mainTree.size(); i++)
-			mainTree[i]->toggleDepthDance();
+	std::string frameName(int index) const {
+		std::string number = std::to_string(index);
+		if ((int)number.size() < numberWidth)
+			number.insert(index < 0 && zeroPadded ? 1 : 0, numberWidth - number.size(), zeroPadded ? '0' : ' ');
+		return namePrefix + number + nameSuffix;
 	}
-	else if (val == 3) {
-		for (int i = 0; i < mainTree.size(); i++)
-			mainTree[i]->toggleLengthDance();
+	bool start(std::ostream &standardOutput) {
+		if (format == FORMAT_PPM && !readPattern()) return false;
+		if (format != FORMAT_PPM) {
+			if (path == "-") {
+#ifdef _WIN32
+				_setmode(_fileno(stdout), _O_BINARY);
+#endif
+				out = &standardOutput;
+			}
+			else {
+				file.open(path.c_str(), std::ios::binary);
+				if (!file) return false;
+				out = &file;
+			}
+		}
+		// full range BT.601, chroma sampled at the center of every 2x2 block
+		if (format == FORMAT_Y4M)
+			*out << "YUV4MPEG2 W" << width << " H" << height << " F" << frameRate << ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+		for (int i = 0; i < EXPORT_POOL_SIZE; i++)
+			freeFrames.push_back(&frames[i]);
+		thread = std::thread(&FrameEncoder::run, this);
+		return true;
 	}
-	else if (val == 4) {
-		for (int i = 0; i < mainTree.size(); i++) {
-			mainTree[i]->toggleRandomness();
-			mainTree[i]->tree->state = rand();
+	// a frame to render into, waits while every one is still queued for writing
+	ExportFrame *acquire() {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !freeFrames.empty(); });
+		ExportFrame *frame = freeFrames.back();
+		freeFrames.pop_back();
+		return frame;
+	}
+	void submit(ExportFrame *frame) {
+		std::lock_guard<std::mutex> lock(mutex);
+		readyFrames.push_back(frame);
+		changed.notify_all();
+	}
+	// writes what is still queued, returns false if any frame could not be written
+	bool finish() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishing = true;
+			changed.notify_all();
 		}
+		thread.join();
+		if (out) out->flush();
+		return !failed && (!out || *out);
 	}
-	else if (val == 5) {
-		for (int i = 0; i < following.size(); i++)
-			following[i]->toggleRunningState();
-		trackingLine->tracking = following[0]->running;
+	void run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			changed.wait(lock, [this] { return finishing || !readyFrames.empty(); });
+			if (readyFrames.empty()) return;
+			ExportFrame *frame = readyFrames.front();
+			readyFrames.pop_front();
+			lock.unlock();
+			time_point<steady_clock> start = steady_clock::now();
+			bool written = !failed && write(*frame);
+			duration<double> elapsed = steady_clock::now() - start;
+			lock.lock();
+			encodeSeconds += elapsed.count();
+			failed = failed || !written;
+			framesWritten += written;
+			freeFrames.push_back(frame);
+			changed.notify_all();
+		}
 	}
-	else if (val == 6) {
-		for (int i = 0; i < following.size(); i++)
-			following[i]->toggleDirection();
+	bool write(const ExportFrame &frame) {
+		const uint32_t *p = &frame.pixels[0];
+		if (format == FORMAT_RGBA) {
+			// already laid out as RGBA bytes, so the frame goes out as it is
+			out->write((const char*)p, frame.pixels.size() * 4);
+			return (bool)*out;
+		}
+		if (format == FORMAT_PPM) {
+			std::ofstream image(frameName(frame.index).c_str(), std::ios::binary);
+			image << "P6\n" << width << " " << height << "\n255\n";
+			converted.resize(frame.pixels.size() * 3);
+			for (size_t i = 0; i < frame.pixels.size(); i++) {
+				converted[i * 3] = (char)(p[i] & 0xff);
+				converted[i * 3 + 1] = (char)(p[i] >> 8 & 0xff);
+				converted[i * 3 + 2] = (char)(p[i] >> 16 & 0xff);
+			}
+			image.write(&converted[0], converted.size());
+			return (bool)image;
+		}
+		// Y4M: a full size luma plane, then quarter size Cb and Cr planes from the average of every 2x2 block
+		int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+		converted.resize(width * height + chromaWidth * chromaHeight * 2);
+		unsigned char *luma = (unsigned char*)&converted[0];
+		unsigned char *cb = luma + width * height, *cr = cb + chromaWidth * chromaHeight;
+		for (int i = 0; i < width * height; i++) {
+			int r = p[i] & 0xff, g = p[i] >> 8 & 0xff, b = p[i] >> 16 & 0xff;
+			luma[i] = (unsigned char)((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+		}
+		for (int cy = 0; cy < chromaHeight; cy++)
+			for (int cx = 0; cx < chromaWidth; cx++) {
+				int r = 0, g = 0, b = 0, n = 0;
+				for (int y = cy * 2; y < std::min(cy * 2 + 2, height); y++)
+					for (int x = cx * 2; x < std::min(cx * 2 + 2, width); x++, n++) {
+						uint32_t c = p[y * width + x];
+						r += c & 0xff;
+						g += c >> 8 & 0xff;
+						b += c >> 16 & 0xff;
+					}
+				// fixed point with 16 fraction bits, the sums hold n pixels
+				int u = (-11059 * r - 21709 * g + 32768 * b) / n, v = (32768 * r - 27439 * g - 5329 * b) / n;
+				cb[cy * chromaWidth + cx] = (unsigned char)std::min(std::max((u + (128 << 16) + 32768) >> 16, 0), 255);
+				cr[cy * chromaWidth + cx] = (unsigned char)std::min(std::max((v + (128 << 16) + 32768) >> 16, 0), 255);
+			}
+		*out << "FRAME\n";
+		out->write(&converted[0], converted.size());
+		return (bool)*out;
+	}
+};
+
+// renders frames at a fixed 1/frameRate step as fast as they can be drawn, not in real time, and streams them
+// to a file or stdout. the encoder works on earlier frames meanwhile, so the time is the slower of the two
+int runExport(int frames, const char *path, int width, int height, int frameRate) {
+	// stdout may carry the frames, so every message goes to stderr
+	std::ostream standardOutput(std::cout.rdbuf());
+	std::streambuf *consoleBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+	SoftwareRenderer softwareRenderer(width, height);
+	useRenderer(&softwareRenderer);
+	initializeScene();
+	FrameEncoder encoder(FrameEncoder::formatOf(path), path, width, height, frameRate);
+	if (!encoder.start(standardOutput)) {
+		if (encoder.format == FrameEncoder::FORMAT_PPM)
+			std::cerr << "A numbered image path needs exactly one %d and no other %, like frame%05d.ppm: " << path << std::endl;
+		else
+			std::cerr << "Could not write " << path << std::endl;
+		std::cout.rdbuf(consoleBuffer);
+		return 1;
+	}
+	const duration<double> frameTime(1.0 / frameRate);
+	double renderSeconds = 0, waitSeconds = 0;
+	time_point<steady_clock> start = steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		time_point<steady_clock> frameStart = steady_clock::now();
+		profiler.beginFrame();
+		advance(frameTime);
+		display();
+		time_point<steady_clock> drawn = steady_clock::now();
+		ExportFrame *frame = encoder.acquire();
+		renderSeconds += duration<double>(drawn - frameStart).count();
+		waitSeconds += duration<double>(steady_clock::now() - drawn).count();
+		frame->index = i;
+		softwareRenderer.exchangeFramebuffer(frame->pixels, frame->tileHashes);
+		encoder.submit(frame);
+	}
+	bool written = encoder.finish();
+	duration<double> elapsed = steady_clock::now() - start;
+	std::cout.rdbuf(consoleBuffer);
+	if (!written) {
+		std::cerr << "Could not write " << path << std::endl;
+		return 1;
 	}
+	std::cerr << "Frames exported: " << encoder.framesWritten << " at " << width << "x" << height << std::endl;
+	std::cerr << "Render time: " << renderSeconds * 1000 / std::max(frames, 1) << " ms per frame" << std::endl;
+	std::cerr << "Encode time: " << encoder.encodeSeconds * 1000 / std::max(frames, 1) << " ms per frame" << std::endl;
+	std::cerr << "Waiting for the encoder: " << waitSeconds * 1000 / std::max(frames, 1) << " ms per frame" << std::endl;
+	std::cerr << "Wall time: " << elapsed.count() << " s, " << frames / std::max(elapsed.count(), 1e-9) << " frames/s" << std::endl;
+	return 0;
 }
 
-void genWave(Vector2f p) {
-	SineWave *sineWave = new SineWave;
-	sineWave->pos = p;
-	sineWave->length = 200 + rand() % 100;
-	sineWave->amplitude = 20 + rand() % 10;
-	sineWave->frequency = 0.15 + 0.10 * (rand() % 31) / 30.0;
-	sineWave->color = getRandomColor();
-	drawables.push_back(sineWave);
-	SineWaveBehavior *sineBehavior = new SineWaveBehavior(sineWave);
-	sineBehavior->shiftRate = 30 + rand() % 30;
-	if (rand() % 2) sineBehavior->shiftRate *= -1;
-	updateBehaviors.push_back(sineBehavior);
-	mainWave.push_back(sineBehavior);
+// the parameters a batch run can sweep: the world's physics, and every genTree parameter of every tree
+// in the scene by its name in the scene file
+struct TreeParameter {
+	const char *name;
+	float TreeRecord::*field;
+};
+const TreeParameter TREE_PARAMETERS[] = {
+	{ "length", &TreeRecord::length }, { "lengthDance", &TreeRecord::lengthDance }, { "depth", &TreeRecord::depth },
+	{ "startAngle", &TreeRecord::startAngle }, { "splitAngleDance", &TreeRecord::splitAngleDance },
+	{ "splitAngleDanceFreq", &TreeRecord::splitAngleDanceFreq }, { "depthDanceFreq", &TreeRecord::depthDanceFreq },
+	{ "lengthDanceFreq", &TreeRecord::lengthDanceFreq }, { "depthDance", &TreeRecord::depthDance },
+	{ "splitAngle", &TreeRecord::splitAngle }, { "splitSizeFactor", &TreeRecord::splitSizeFactor }
+};
+const int PATH_SAMPLE_STEPS = 30; // the player path keeps every this many steps
+
+struct Sweep {
+	std::string name;
+	float min, max;
+};
+
+struct WorldResult {
+	std::vector<float> values; // one for every sweep
+	double stepNanoseconds = 0, drawNanoseconds = 0; // per frame
+	uint64_t vertices = 0; // per frame
+	float pathLength = 0; // how far the player went, step by step
+	std::vector<Vector2f> path;
+};
+
+bool isSweepParameter(const std::string &name) {
+	if (name == "gravity" || name == "drag") return true;
+	for (size_t i = 0; i < sizeof(TREE_PARAMETERS) / sizeof(TREE_PARAMETERS[0]); i++)
+		if (name == TREE_PARAMETERS[i].name) return true;
+	return false;
 }
 
-void genTree(Vector2f p, int length = 70, int lengthDance = 35, int depth = 9, int startAngle = 0,
-	float splitAngleDance = 24, float splitAngleDanceFreq = 0.8, float depthDanceFreq = 0.2,
-	float lengthDanceFreq = 0.3, int depthDance = 4, float splitAngle = 40, float splitSizeFactor = 0.8) {
-	Tree *tree = new Tree;
-	tree->pos = p;
-	tree->startAngle = startAngle;
-	tree->splitAngle = splitAngle;
-	tree->depth = depth;
-	tree->length = length;
-	tree->splitSizeFactor = splitSizeFactor;
-	drawables.push_back(tree);
-	TreeBehavior *tb = new TreeBehavior(tree);
-	tb->splitAngleDance = splitAngleDance;
-	tb->splitAngleDanceFreq = splitAngleDanceFreq;
-	tb->depthDance = depthDance;
-	tb->depthDanceFreq = depthDanceFreq;
-	tb->lengthDance = lengthDance;
-	tb->lengthDanceFreq = lengthDanceFreq;
-	updateBehaviors.push_back(tb);
-	mainTree.push_back(tb);
-}
-
-PathFollowingBehavior* genMovingCircle(std::vector<Vector2f> &positions, int rounds, int index, Vector3f color, float radius) {
-	PathFollowingBehavior *following = new PathFollowingBehavior;
-	following->positions = positions;
-	Circle *circle = genCircle(following->positions[0]);
-	circle->shiftFunc = NULL;
-	circle->radius = { radius, radius };
-	circle->color = color;
-	circle->rounds = rounds;
-	following->mover = circle;
-	following->moveDelay = 0.1;
-	following->idx = index;
-	drawables.push_back(circle);
-	updateBehaviors.push_back(following);
-	::following.push_back(following);
-	return following;
+// builds one world of a batch on the running thread, plays it and measures it, then throws it away
+void runBatchWorld(const SceneView &scene, const std::vector<Sweep> &sweeps, uint32_t seed, int frames, WorldResult &result) {
+	std::unique_ptr<World> own(new World);
+	World *previousWorld = world;
+	IRenderer *previousRenderer = renderer, *previousBackend = renderQueue.backend;
+	bool previousInline = jobsInline;
+	world = own.get();
+	// the other threads are busy with worlds of their own, and this one's numbers should only count this world
+	jobsInline = true;
+	NullRenderer nullRenderer;
+	useRenderer(&nullRenderer);
+
+	world->seed(seed);
+	std::vector<TreeRecord> trees(scene.trees, scene.trees + scene.header.treeCount);
+	float gravity = GRAVITY, drag = PLAYER_DRAG;
+	for (size_t s = 0; s < sweeps.size(); s++) {
+		float value = result.values[s];
+		if (sweeps[s].name == "gravity") gravity = value;
+		else if (sweeps[s].name == "drag") drag = value;
+		for (size_t p = 0; p < sizeof(TREE_PARAMETERS) / sizeof(TREE_PARAMETERS[0]); p++)
+			if (sweeps[s].name == TREE_PARAMETERS[p].name)
+				for (size_t t = 0; t < trees.size(); t++)
+					trees[t].*TREE_PARAMETERS[p].field = value;
+	}
+	SceneView view = scene;
+	view.trees = trees.empty() ? NULL : &trees[0];
+	world->setPhysics(gravity, drag);
+	buildScene(view, true);
+	// the trees dance every way they can and the movers run, as if all of it was turned on from the menu
+	mainMenu(1);
+	mainMenu(2);
+	mainMenu(3);
+	mainMenu(5);
+
+	int64_t stepTime = 0, drawTime = 0;
+	uint64_t verticesBefore = verticesEmitted;
+	result.path.push_back(world->playerPosition);
+	for (int i = 0; i < frames; i++) {
+		time_point<steady_clock> start = steady_clock::now();
+		advance(FIXED_TIME_STEP);
+		time_point<steady_clock> stepped = steady_clock::now();
+		display();
+		time_point<steady_clock> drawn = steady_clock::now();
+		stepTime += duration_cast<nanoseconds>(stepped - start).count();
+		drawTime += duration_cast<nanoseconds>(drawn - stepped).count();
+		result.pathLength += distance(world->previousPlayerPosition, world->playerPosition);
+		if (world->steps % PATH_SAMPLE_STEPS == 0)
+			result.path.push_back(world->playerPosition);
+	}
+	result.stepNanoseconds = (double)stepTime / std::max(frames, 1);
+	result.drawNanoseconds = (double)drawTime / std::max(frames, 1);
+	result.vertices = (verticesEmitted - verticesBefore) / std::max(frames, 1);
+
+	renderQueue.backend = previousBackend;
+	renderer = previousRenderer;
+	jobsInline = previousInline;
+	world = previousWorld;
 }
-void initialize() {
-	srand(time(NULL));
-	glutDisplayFunc(display);
-	glutIdleFunc(update);
-	glutMouseFunc(click);
-	glutReshapeFunc(reshape);
-	glutPassiveMotionFunc(passiveMotion);
-	glutKeyboardFunc(keyboard);
-	glutKeyboardUpFunc(keyboardUp);
 
-	std::cout << "=== INSTRUCTIONS ===" << std::endl;
-	std::cout << "Move the player using WASD key" << std::endl;
-	std::cout << "Right-click to open menu" << std::endl;
-	std::cout << "Left-click to spawn new random object" << std::endl;
-	std::cout << std::endl;
-	std::cout << "=== LOGS ===" << std::endl;
-	glutCreateMenu(mainMenu);
-	glutAddMenuEntry("Toggle Tree Split Angle Dance", 1);
-	glutAddMenuEntry("Toggle Tree Depth Dance", 2);
-	glutAddMenuEntry("Toggle Tree Length Dance", 3);
-	glutAddMenuEntry("Toggle Tree Symmetry/Asymmetry", 4);
-	glutAddMenuEntry("Toggle Mover Running State", 5);
-	glutAddMenuEntry("Toggle Mover Direction", 6);
-	glutAddMenuEntry("Toggle Wave Direction", 0);
-	glutAttachMenu(GLUT_RIGHT_BUTTON);
-	//Point *middle = new Point;
-	//middle->pos = { 0, 0 };
-	//drawables.push_back(middle);
-	genTree({ -5, -120 });
-	genTree({ -312, -173 }, 30, 10, 4, 10, 10, 1.5, 0.75, 0.4, 2, 25, 0.9);
-	genTree({ 281, -232 }, 30, 10, 7, -20, 15, 2.0, 0.9, 0.8, 3, 30, 0.8);
+// plays many copies of the scene side by side without a window, each with its own values of the swept
+// parameters, and prints what every world cost and where its player went as JSON. every world starts from
+// the same seed, so only the parameters tell them apart. a parameter takes evenly spaced values from min
+// to max across the worlds, and every further parameter walks through the same values in its own shuffled
+// order, so any number of parameters is covered by worldCount worlds
+int runBatch(int worldCount, int frames, const std::vector<Sweep> &sweeps, uint32_t seed, const char *outputPath) {
+	for (size_t s = 0; s < sweeps.size(); s++)
+		if (!isSweepParameter(sweeps[s].name)) {
+			std::cerr << "Unknown sweep parameter " << sweeps[s].name << ", use gravity, drag or a tree parameter:";
+			for (size_t p = 0; p < sizeof(TREE_PARAMETERS) / sizeof(TREE_PARAMETERS[0]); p++)
+				std::cerr << " " << TREE_PARAMETERS[p].name;
+			std::cerr << std::endl;
+			return 1;
+		}
+	MappedFile file;
+	SceneText text;
+	SceneView scene;
+	std::string error;
+	if (!readScene(SCENE_PATH, file, text, scene, error)) {
+		std::cerr << "Could not load scene " << SCENE_PATH << ": " << error << std::endl;
+		scene = SceneView();
+	}
+	std::vector<WorldResult> results(worldCount);
+	for (size_t s = 0; s < sweeps.size(); s++) {
+		std::vector<int> order(worldCount);
+		for (int i = 0; i < worldCount; i++)
+			order[i] = i;
+		for (int i = worldCount - 1; i > 0 && s > 0; i--)
+			std::swap(order[i], order[hashRandom(seed, s * worldCount + i) % (i + 1)]);
+		for (int i = 0; i < worldCount; i++) {
+			float t = worldCount > 1 ? order[i] / (float)(worldCount - 1) : 0.5f;
+			results[i].values.push_back(sweeps[s].min + (sweeps[s].max - sweeps[s].min) * t);
+		}
+	}
+
+	// one world per job, the profiler would get every world's phases mixed into one frame
+	profiler.enabled = false;
+	std::cerr << "Running " << worldCount << " worlds for " << frames << " frames on " << jobs.threadCount() << " threads" << std::endl;
+	time_point<steady_clock> start = steady_clock::now();
+	jobs.parallelFor(worldCount, 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			runBatchWorld(scene, sweeps, seed, frames, results[i]);
+	});
+	duration<double> elapsed = steady_clock::now() - start;
+	profiler.enabled = true;
+	std::cerr << "Done in " << elapsed.count() << " s, " << worldCount / std::max(elapsed.count(), 1e-9) << " worlds per second" << std::endl;
+
+	std::ostringstream json;
+	json << "{\n  \"worlds\": " << worldCount << ",\n  \"frames\": " << frames << ",\n  \"seed\": " << seed
+		<< ",\n  \"threads\": " << jobs.threadCount() << ",\n  \"seconds\": " << elapsed.count() << ",\n  \"sweeps\": [";
+	for (size_t s = 0; s < sweeps.size(); s++)
+		json << (s ? ", " : "") << "{ \"name\": \"" << sweeps[s].name << "\", \"min\": " << sweeps[s].min << ", \"max\": " << sweeps[s].max << " }";
+	json << "],\n  \"results\": [\n";
+	for (int i = 0; i < worldCount; i++) {
+		const WorldResult &r = results[i];
+		json << "    { \"world\": " << i;
+		for (size_t s = 0; s < sweeps.size(); s++)
+			json << ", \"" << sweeps[s].name << "\": " << r.values[s];
+		json << ", \"nsPerStep\": " << (int64_t)r.stepNanoseconds << ", \"nsPerDraw\": " << (int64_t)r.drawNanoseconds
+			<< ", \"verticesPerFrame\": " << r.vertices << ", \"pathLength\": " << r.pathLength << ", \"path\": [";
+		for (size_t j = 0; j < r.path.size(); j++)
+			json << (j ? ", " : "") << "[" << r.path[j].x << ", " << r.path[j].y << "]";
+		json << "] }" << (i + 1 < worldCount ? "," : "") << "\n";
+	}
+	json << "  ]\n}\n";
+	std::cout << json.str();
+	if (outputPath) {
+		std::ofstream output(outputPath);
+		output << json.str();
+		if (!output) {
+			std::cerr << "Could not write " << outputPath << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// reports how long one simulation step takes when the behaviors are spread over 1, 2, ... up to maxThreads threads
+int runScaling(int steps, int maxThreads) {
+	initializeScene();
+	// a crowded scene, so there is enough independent work to spread
+	for (int i = 0; i < 100000; i++) {
+		Vector2f p = { (float)(world->random() % W - W / 2), (float)(world->random() % H - H / 2) };
+		genCircle(p);
+		genTriangle(p);
+	}
+	for (int i = 0; i < 1000; i++)
+		genWave({ (float)(world->random() % W - W / 2), (float)(world->random() % H - H / 2) });
+	double oneThread = 0;
+	for (int threads = 1; threads <= maxThreads; threads++) {
+		jobs.start(threads);
+		time_point<steady_clock> start = steady_clock::now();
+		for (int i = 0; i < steps; i++)
+			simulate();
+		duration<double> elapsed = steady_clock::now() - start;
+		double stepTime = elapsed.count() * 1000 / std::max(steps, 1);
+		if (threads == 1) oneThread = stepTime;
+		std::cout << "Threads: " << threads << "  Step time: " << stepTime << " ms  Speedup: " << oneThread / stepTime << "x" << std::endl;
+	}
+	return 0;
+}
+
+// rasterizes a crowded scene into a large framebuffer, repainting every tile every frame, and reports
+// how many million pixels per second the software renderer fills on 1, 2, 4, 8 and 16 threads
+int runRasterBenchmark(int frames, int width, int height) {
+	SoftwareRenderer softwareRenderer(width, height);
+	softwareRenderer.dirtyTracking = false;
+	useRenderer(&softwareRenderer);
+	initializeScene();
+	for (int i = 0; i < 2000; i++) {
+		genCircle(randomWorldPosition());
+		genTriangle(randomWorldPosition());
+	}
+	std::vector<Profiler::FrameSample> samples;
+	double oneThread = 0;
+	for (int threads = 1; threads <= 16; threads *= 2) {
+		jobs.start(threads);
+		display(); // warm up, buffers grow to their size here
+		for (int i = 0; i < frames; i++) {
+			profiler.beginFrame();
+			display();
+		}
+		// only the rasterization, which happens when the frame is handed over
+		profiler.frames.copyNewest(frames, samples);
+		int64_t rasterTime = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+			rasterTime += samples[i].phases[PHASE_SWAP_BUFFERS];
+		double megapixels = (double)width * height * frames / std::max(rasterTime / 1e3, 1.0);
+		if (threads == 1) oneThread = megapixels;
+		std::cout << "Threads: " << threads << "  Raster time: " << rasterTime / 1e6 / std::max(frames, 1) << " ms  "
+			<< megapixels << " Mpixels/s  Speedup: " << megapixels / oneThread << "x" << std::endl;
+	}
+	resetScene();
+	useRenderer(&glRenderer);
+	return 0;
+}
 
-	genWave({ 0, -200 });
-	genWave({ 0, -230 });
-	genWave({ 0, -260 });
+// how many random numbers per second the tree generator can draw, next to libc's rand() for scale
+int runRandomBenchmark() {
+	const int count = 50000000;
+	uint32_t seed = (uint32_t)rand();
+	unsigned int sum = 0; // printed so the loops are not optimized away
+	time_point<steady_clock> start = steady_clock::now();
+	for (int i = 0; i < count; i++)
+		sum += hashRandom(seed, i);
+	duration<double> hashTime = steady_clock::now() - start;
+	start = steady_clock::now();
+	for (int i = 0; i < count; i++)
+		sum += rand();
+	duration<double> randTime = steady_clock::now() - start;
+	std::cout << "hashRandom: " << count / hashTime.count() / 1e6 << " million numbers per second" << std::endl;
+	std::cout << "rand: " << count / randTime.count() / 1e6 << " million numbers per second" << std::endl;
+	std::cout << "(checksum " << sum << ")" << std::endl;
+	return 0;
+}
 
-	for (int i = 0; i < 10; i++)
-		genCircle({ -303, 228 }, 1.0f - 0.2f + 0.4f * (rand() % 100 / 99.0f));
+// times range and nearest queries through the grid against scanning every entity, at growing populations
+int runGridBenchmark() {
+	const int queryCount = 10000;
+	const int counts[] = { 1000, 10000, 100000 };
+	for (int c = 0; c < 3; c++) {
+		int count = counts[c];
+		resetScene();
+		for (int i = 0; i < count; i++) {
+			Circle circle;
+			float radius = 2 + rand() % 3;
+			circle.radius = { radius, radius };
+			world->circles.add(circle, { (rand() % (W * 100)) / 100.0f - W / 2, (rand() % (H * 100)) / 100.0f - H / 2 }, 0, 0);
+		}
+		std::vector<Vector2f> queries;
+		for (int i = 0; i < queryCount; i++)
+			queries.push_back({ (rand() % (W * 100)) / 100.0f - W / 2, (rand() % (H * 100)) / 100.0f - H / 2 });
+		const float range = 8;
+		int64_t gridFound = 0, scanFound = 0, mismatches = 0;
+		time_point<steady_clock> start = steady_clock::now();
+		for (int q = 0; q < queryCount; q++)
+			world->circles.queryRange(queries[q], range, [&](int i) { gridFound++; });
+		duration<double, std::nano> gridRange = steady_clock::now() - start;
+		start = steady_clock::now();
+		for (int q = 0; q < queryCount; q++)
+			for (int i = 0; i < count; i++) {
+				float r = range + world->circles.boundOf(i);
+				if (sqrDistance(world->circles.pos[i], queries[q]) <= r * r) scanFound++;
+			}
+		duration<double, std::nano> scanRange = steady_clock::now() - start;
+		std::vector<int> gridNearest(queryCount);
+		start = steady_clock::now();
+		for (int q = 0; q < queryCount; q++)
+			gridNearest[q] = world->circles.nearest(queries[q]);
+		duration<double, std::nano> gridNearestTime = steady_clock::now() - start;
+		start = steady_clock::now();
+		for (int q = 0; q < queryCount; q++) {
+			int best = 0;
+			for (int i = 1; i < count; i++)
+				if (sqrDistance(world->circles.pos[i], queries[q]) < sqrDistance(world->circles.pos[best], queries[q])) best = i;
+			if (sqrDistance(world->circles.pos[best], queries[q]) != sqrDistance(world->circles.pos[gridNearest[q]], queries[q])) mismatches++;
+		}
+		duration<double, std::nano> scanNearestTime = steady_clock::now() - start;
+		int64_t pairs = 0;
+		start = steady_clock::now();
+		world->circles.queryPairs([&](int a, int b) { pairs++; });
+		duration<double, std::milli> pairTime = steady_clock::now() - start;
+		std::cout << count << " world->circles, " << world->circles.grid.columns << "x" << world->circles.grid.rows << " cells" << std::endl;
+		std::cout << "  range:   grid " << gridRange.count() / queryCount << " ns, scan " << scanRange.count() / queryCount
+			<< " ns per query (" << gridFound << " vs " << scanFound << " found)" << std::endl;
+		std::cout << "  nearest: grid " << gridNearestTime.count() / queryCount << " ns, scan " << scanNearestTime.count() / queryCount
+			<< " ns per query (" << mismatches << " mismatches)" << std::endl;
+		std::cout << "  pairs:   " << pairs << " overlapping in " << pairTime.count() << " ms" << std::endl;
+	}
+	resetScene();
+	return 0;
+}
 
-	for (int i = 0; i < 5; i++)
-		genTriangle({ 300, 200 });
+// steps a large particle system on its own, without a window or the rest of the scene
+int runParticleBenchmark(int count, int steps) {
+	resetScene();
+	world->particles.limit = count;
+	for (int i = 0; i < count; i += 1000)
+		world->particles.burst({ 0, 0 }, std::min(1000, count - i), 900);
+	time_point<steady_clock> start = steady_clock::now();
+	for (int i = 0; i < steps; i++)
+		world->particles.update(i * (float)FIXED_TIME_STEP.count(), (float)FIXED_TIME_STEP.count());
+	duration<double> elapsed = steady_clock::now() - start;
+	NullRenderer nullRenderer;
+	renderer = &nullRenderer;
+	start = steady_clock::now();
+	world->particles.draw();
+	duration<double, std::milli> drawTime = steady_clock::now() - start;
+	std::cout << count << " world->particles on " << jobs.threadCount() << " threads: " << steps / elapsed.count() << " steps per second, "
+		<< count * (double)steps / elapsed.count() / 1e6 << " million particle steps per second" << std::endl;
+	std::cout << "Filling the point batch took " << drawTime.count() << " ms" << std::endl;
+	renderer = &glRenderer;
+	resetScene();
+	world->particles.limit = PARTICLE_LIMIT;
+	return 0;
+}
 
-	std::vector<Vector2f> positions = { { -330,-254 },{ -332,-254 },{ -340,-247 },{ -344,-243 },{ -347,-239 },{ -350,-236 },{ -354,-233 },{ -359,-228 },{ -364,-222 },{ -367,-214 },{ -369,-210 },{ -370,-207 },{ -372,-198 },{ -374,-189 },{ -374,-174 },{ -375,-168 },{ -377,-156 },{ -378,-148 },{ -378,-139 },{ -379,-116 },{ -379,-93 },{ -376,-72 },{ -369,-59 },{ -356,-49 },{ -344,-43 },{ -329,-43 },{ -314,-46 },{ -305,-48 },{ -288,-50 },{ -275,-58 },{ -263,-81 },{ -249,-123 },{ -243,-140 },{ -240,-161 },{ -237,-183 },{ -247,-216 },{ -261,-236 },{ -270,-255 },{ -266,-271 },{ -234,-278 },{ -220,-278 },{ -203,-275 },{ -183,-268 },{ -173,-260 },{ -170,-242 },{ -175,-223 },{ -182,-200 },{ -209,-196 },{ -242,-214 },{ -262,-223 },{ -301,-226 },{ -320,-224 },{ -344,-213 },{ -370,-185 },{ -373,-152 },{ -373,-122 },{ -373,-100 },{ -370,-73 },{ -367,-57 },{ -364,-35 },{ -355,-11 },{ -344,10 },{ -334,30 },{ -320,44 },{ -309,63 },{ -300,82 },{ -288,92 },{ -260,104 },{ -239,115 },{ -227,121 },{ -191,142 },{ -151,174 },{ -126,192 },{ -102,206 },{ -86,201 },{ -88,167 },{ -170,145 },{ -187,189 },{ -166,218 },{ -126,239 },{ -97,254 },{ -70,262 },{ -8,263 },{ 34,261 },{ 55,257 },{ 79,246 },{ 100,223 },{ 116,200 },{ 134,182 },{ 152,169 },{ 183,169 },{ 212,205 },{ 220,240 },{ 207,267 },{ 134,286 },{ 32,271 },{ -4,256 },{ -25,233 },{ -28,217 },{ 34,198 },{ 106,183 },{ 174,150 },{ 258,107 },{ 323,86 },{ 352,45 },{ 363,-29 },{ 327,-68 },{ 231,6 },{ 304,108 },{ 315,7 },{ 233,-9 },{ 290,87 },{ 348,40 },{ 354,10 },{ 299,-28 },{ 243,16 },{ 278,76 },{ 347,54 },{ 367,-12 },{ 337,-42 },{ 246,-75 },{ 198,-143 },{ 195,-177 },{ 239,-213 },{ 282,-234 },{ 318,-253 },{ 366,-250 },{ 364,-229 },{ 331,-240 },{ 345,-267 },{ 299,-279 },{ 235,-274 },{ 207,-274 },{ 175,-264 },{ 190,-243 },{ 233,-257 },{ 221,-272 },{ 193,-259 },{ 211,-237 },{ 228,-228 },{ 217,-200 },{ 174,-200 },{ 196,-229 },{ 211,-192 },{ 194,-178 },{ 146,-156 },{ 182,-130 },{ 197,-143 },{ 185,-182 },{ 142,-183 },{ 126,-162 },{ 102,-158 },{ 107,-179 },{ 91,-186 },{ 7,-207 },{ -88,-200 },{ -161,-185 },{ -107,-167 },{ -107,-223 },{ -98,-198 },{ -96,-254 },{ -87,-196 },{ -57,-215 },{ -48,-244 },{ -17,-243 },{ 37,-222 },{ 110,-230 },{ 158,-246 },{ 168,-218 },{ 161,-176 },{ 114,-165 },{ 19,-162 },{ -42,-159 },{ -110,-159 },{ -168,-154 },{ -198,-146 },{ -201,-137 },{ -178,-134 },{ -135,-140 },{ -40,-145 },{ 13,-143 },{ 86,-146 },{ 142,-146 },{ 177,-142 },{ 183,-130 },{ 159,-124 },{ 129,-138 },{ 84,-153 },{ 21,-153 },{ -45,-150 },{ -85,-146 },{ -115,-145 },{ -142,-143 },{ -161,-139 },{ -150,-137 },{ -117,-138 },{ -101,-141 },{ -81,-140 },{ -51,-142 },{ -1,-144 },{ 39,-144 },{ 72,-146 },{ 124,-149 },{ 159,-146 },{ 157,-137 },{ 115,-136 },{ 90,-154 },{ 71,-130 },{ 118,-143 },{ 95,-155 },{ 40,-147 },{ 66,-126 },{ 108,-133 },{ 85,-149 },{ 1,-148 },{ 27,-126 },{ 42,-153 },{ -48,-148 },{ 2,-130 },{ -31,-154 },{ -84,-134 },{ -68,-134 },{ -119,-153 },{ -112,-130 },{ -138,-146 },{ -123,-142 },{ -155,-133 },{ -158,-141 },{ -113,-122 },{ -72,-126 },{ -21,-136 },{ 15,-139 },{ 61,-145 },{ 128,-141 },{ 154,-120 },{ 147,-120 },{ 107,-132 },{ 47,-139 },{ -17,-141 },{ -71,-142 },{ -149,-128 },{ -176,-145 },{ -189,-164 },{ -188,-199 },{ -183,-243 },{ -206,-268 },{ -223,-221 },{ -214,-183 },{ -214,-154 },{ -221,-139 },{ -253,-73 },{ -257,18 },{ -203,150 },{ -134,207 },{ 38,227 },{ 105,218 },{ -18,239 },{ -138,161 },{ -206,59 },{ -225,-48 },{ -209,-123 },{ -198,-138 },{ -190,-153 },{ -176,-181 },{ -171,-206 },{ -171,-221 },{ -172,-234 },{ -171,-239 },{ -170,-248 },{ -170,-250 },{ -170,-255 },{ -170,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -174,-256 },{ -177,-256 },{ -181,-255 },{ -182,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -196,-254 },{ -196,-254 },{ -202,-254 },{ -203,-254 },{ -218,-254 },{ -218,-254 },{ -226,-254 },{ -226,-254 },{ -233,-254 },{ -233,-254 },{ -247,-254 },{ -247,-254 },{ -250,-254 },{ -250,-254 },{ -253,-254 },{ -253,-254 },{ -262,-254 },{ -262,-254 },{ -267,-254 },{ -267,-254 },{ -281,-256 },{ -281,-256 },{ -302,-258 },{ -302,-258 },{ -314,-258 },{ -316,-258 },{ -322,-258 },{ -330,-254 },{ -332,-254 },{ -340,-247 },{ -344,-243 },{ -347,-239 },{ -350,-236 },{ -354,-233 },{ -359,-228 },{ -364,-222 },{ -367,-214 },{ -369,-210 },{ -370,-207 },{ -372,-198 },{ -374,-189 },{ -374,-174 },{ -375,-168 },{ -377,-156 },{ -378,-148 },{ -378,-139 },{ -379,-116 },{ -379,-93 },{ -376,-72 },{ -369,-59 },{ -356,-49 },{ -344,-43 },{ -329,-43 },{ -314,-46 },{ -305,-48 },{ -288,-50 },{ -275,-58 },{ -263,-81 },{ -249,-123 },{ -243,-140 },{ -240,-161 },{ -237,-183 },{ -247,-216 },{ -261,-236 },{ -270,-255 },{ -266,-271 },{ -234,-278 },{ -220,-278 },{ -203,-275 },{ -183,-268 },{ -173,-260 },{ -170,-242 },{ -175,-223 },{ -182,-200 },{ -209,-196 },{ -242,-214 },{ -262,-223 },{ -301,-226 },{ -320,-224 },{ -344,-213 },{ -370,-185 },{ -373,-152 },{ -373,-122 },{ -373,-100 },{ -370,-73 },{ -367,-57 },{ -364,-35 },{ -355,-11 },{ -344,10 },{ -334,30 },{ -320,44 },{ -309,63 },{ -300,82 },{ -288,92 },{ -260,104 },{ -239,115 },{ -227,121 },{ -191,142 },{ -151,174 },{ -126,192 },{ -102,206 },{ -86,201 },{ -88,167 },{ -170,145 },{ -187,189 },{ -166,218 },{ -126,239 },{ -97,254 },{ -70,262 },{ -8,263 },{ 34,261 },{ 55,257 },{ 79,246 },{ 100,223 },{ 116,200 },{ 134,182 },{ 152,169 },{ 183,169 },{ 212,205 },{ 220,240 },{ 207,267 },{ 134,286 },{ 32,271 },{ -4,256 },{ -25,233 },{ -28,217 },{ 34,198 },{ 106,183 },{ 174,150 },{ 258,107 },{ 323,86 },{ 352,45 },{ 363,-29 },{ 327,-68 },{ 231,6 },{ 304,108 },{ 315,7 },{ 233,-9 },{ 290,87 },{ 348,40 },{ 354,10 },{ 299,-28 },{ 243,16 },{ 278,76 },{ 347,54 },{ 367,-12 },{ 337,-42 },{ 246,-75 },{ 198,-143 },{ 195,-177 },{ 239,-213 },{ 282,-234 },{ 318,-253 },{ 366,-250 },{ 364,-229 },{ 331,-240 },{ 345,-267 },{ 299,-279 },{ 235,-274 },{ 207,-274 },{ 175,-264 },{ 190,-243 },{ 233,-257 },{ 221,-272 },{ 193,-259 },{ 211,-237 },{ 228,-228 },{ 217,-200 },{ 174,-200 },{ 196,-229 },{ 211,-192 },{ 194,-178 },{ 146,-156 },{ 182,-130 },{ 197,-143 },{ 185,-182 },{ 142,-183 },{ 126,-162 },{ 102,-158 },{ 107,-179 },{ 91,-186 },{ 7,-207 },{ -88,-200 },{ -161,-185 },{ -107,-167 },{ -107,-223 },{ -98,-198 },{ -96,-254 },{ -87,-196 },{ -57,-215 },{ -48,-244 },{ -17,-243 },{ 37,-222 },{ 110,-230 },{ 158,-246 },{ 168,-218 },{ 161,-176 },{ 114,-165 },{ 19,-162 },{ -42,-159 },{ -110,-159 },{ -168,-154 },{ -198,-146 },{ -201,-137 },{ -178,-134 },{ -135,-140 },{ -40,-145 },{ 13,-143 },{ 86,-146 },{ 142,-146 },{ 177,-142 },{ 183,-130 },{ 159,-124 },{ 129,-138 },{ 84,-153 },{ 21,-153 },{ -45,-150 },{ -85,-146 },{ -115,-145 },{ -142,-143 },{ -161,-139 },{ -150,-137 },{ -117,-138 },{ -101,-141 },{ -81,-140 },{ -51,-142 },{ -1,-144 },{ 39,-144 },{ 72,-146 },{ 124,-149 },{ 159,-146 },{ 157,-137 },{ 115,-136 },{ 90,-154 },{ 71,-130 },{ 118,-143 },{ 95,-155 },{ 40,-147 },{ 66,-126 },{ 108,-133 },{ 85,-149 },{ 1,-148 },{ 27,-126 },{ 42,-153 },{ -48,-148 },{ 2,-130 },{ -31,-154 },{ -84,-134 },{ -68,-134 },{ -119,-153 },{ -112,-130 },{ -138,-146 },{ -123,-142 },{ -155,-133 },{ -158,-141 },{ -113,-122 },{ -72,-126 },{ -21,-136 },{ 15,-139 },{ 61,-145 },{ 128,-141 },{ 154,-120 },{ 147,-120 },{ 107,-132 },{ 47,-139 },{ -17,-141 },{ -71,-142 },{ -149,-128 },{ -176,-145 },{ -189,-164 },{ -188,-199 },{ -183,-243 },{ -206,-268 },{ -223,-221 },{ -214,-183 },{ -214,-154 },{ -221,-139 },{ -253,-73 },{ -257,18 },{ -203,150 },{ -134,207 },{ 38,227 },{ 105,218 },{ -18,239 },{ -138,161 },{ -206,59 },{ -225,-48 },{ -209,-123 },{ -198,-138 },{ -190,-153 },{ -176,-181 },{ -171,-206 },{ -171,-221 },{ -172,-234 },{ -171,-239 },{ -170,-248 },{ -170,-250 },{ -170,-255 },{ -170,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -174,-256 },{ -177,-256 },{ -181,-255 },{ -182,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -196,-254 },{ -196,-254 },{ -202,-254 },{ -203,-254 },{ -218,-254 },{ -218,-254 },{ -226,-254 },{ -226,-254 },{ -233,-254 },{ -233,-254 },{ -247,-254 },{ -247,-254 },{ -250,-254 },{ -250,-254 },{ -253,-254 },{ -253,-254 },{ -262,-254 },{ -262,-254 },{ -267,-254 },{ -267,-254 },{ -281,-256 },{ -281,-256 },{ -302,-258 },{ -302,-258 },{ -314,-258 },{ -316,-258 },{ -322,-258 },{ -322,-258 },{ -330,-254 },{ -332,-254 },{ -340,-247 },{ -344,-243 },{ -347,-239 },{ -350,-236 },{ -354,-233 },{ -359,-228 },{ -364,-222 },{ -367,-214 },{ -369,-210 },{ -370,-207 },{ -372,-198 },{ -374,-189 },{ -374,-174 },{ -375,-168 },{ -377,-156 },{ -378,-148 },{ -378,-139 },{ -379,-116 },{ -379,-93 },{ -376,-72 },{ -369,-59 },{ -356,-49 },{ -344,-43 },{ -329,-43 },{ -314,-46 },{ -305,-48 },{ -288,-50 },{ -275,-58 },{ -263,-81 },{ -249,-123 },{ -243,-140 },{ -240,-161 },{ -237,-183 },{ -247,-216 },{ -261,-236 },{ -270,-255 },{ -266,-271 },{ -234,-278 },{ -220,-278 },{ -203,-275 },{ -183,-268 },{ -173,-260 },{ -170,-242 },{ -175,-223 },{ -182,-200 },{ -209,-196 },{ -242,-214 },{ -262,-223 },{ -301,-226 },{ -320,-224 },{ -344,-213 },{ -370,-185 },{ -373,-152 },{ -373,-122 },{ -373,-100 },{ -370,-73 },{ -367,-57 },{ -364,-35 },{ -355,-11 },{ -344,10 },{ -334,30 },{ -320,44 },{ -309,63 },{ -300,82 },{ -288,92 },{ -260,104 },{ -239,115 },{ -227,121 },{ -191,142 },{ -151,174 },{ -126,192 },{ -102,206 },{ -86,201 },{ -88,167 },{ -170,145 },{ -187,189 },{ -166,218 },{ -126,239 },{ -97,254 },{ -70,262 },{ -8,263 },{ 34,261 },{ 55,257 },{ 79,246 },{ 100,223 },{ 116,200 },{ 134,182 },{ 152,169 },{ 183,169 },{ 212,205 },{ 220,240 },{ 207,267 },{ 134,286 },{ 32,271 },{ -4,256 },{ -25,233 },{ -28,217 },{ 34,198 },{ 106,183 },{ 174,150 },{ 258,107 },{ 323,86 },{ 352,45 },{ 363,-29 },{ 327,-68 },{ 231,6 },{ 304,108 },{ 315,7 },{ 233,-9 },{ 290,87 },{ 348,40 },{ 354,10 },{ 299,-28 },{ 243,16 },{ 278,76 },{ 347,54 },{ 367,-12 },{ 337,-42 },{ 246,-75 },{ 198,-143 },{ 195,-177 },{ 239,-213 },{ 282,-234 },{ 318,-253 },{ 366,-250 },{ 364,-229 },{ 331,-240 },{ 345,-267 },{ 299,-279 },{ 235,-274 },{ 207,-274 },{ 175,-264 },{ 190,-243 },{ 233,-257 },{ 221,-272 },{ 193,-259 },{ 211,-237 },{ 228,-228 },{ 217,-200 },{ 174,-200 },{ 196,-229 },{ 211,-192 },{ 194,-178 },{ 146,-156 },{ 182,-130 },{ 197,-143 },{ 185,-182 },{ 142,-183 },{ 126,-162 },{ 102,-158 },{ 107,-179 },{ 91,-186 },{ 7,-207 },{ -88,-200 },{ -161,-185 },{ -107,-167 },{ -107,-223 },{ -98,-198 },{ -96,-254 },{ -87,-196 },{ -57,-215 },{ -48,-244 },{ -17,-243 },{ 37,-222 },{ 110,-230 },{ 158,-246 },{ 168,-218 },{ 161,-176 },{ 114,-165 },{ 19,-162 },{ -42,-159 },{ -110,-159 },{ -168,-154 },{ -198,-146 },{ -201,-137 },{ -178,-134 },{ -135,-140 },{ -40,-145 },{ 13,-143 },{ 86,-146 },{ 142,-146 },{ 177,-142 },{ 183,-130 },{ 159,-124 },{ 129,-138 },{ 84,-153 },{ 21,-153 },{ -45,-150 },{ -85,-146 },{ -115,-145 },{ -142,-143 },{ -161,-139 },{ -150,-137 },{ -117,-138 },{ -101,-141 },{ -81,-140 },{ -51,-142 },{ -1,-144 },{ 39,-144 },{ 72,-146 },{ 124,-149 },{ 159,-146 },{ 157,-137 },{ 115,-136 },{ 90,-154 },{ 71,-130 },{ 118,-143 },{ 95,-155 },{ 40,-147 },{ 66,-126 },{ 108,-133 },{ 85,-149 },{ 1,-148 },{ 27,-126 },{ 42,-153 },{ -48,-148 },{ 2,-130 },{ -31,-154 },{ -84,-134 },{ -68,-134 },{ -119,-153 },{ -112,-130 },{ -138,-146 },{ -123,-142 },{ -155,-133 },{ -158,-141 },{ -113,-122 },{ -72,-126 },{ -21,-136 },{ 15,-139 },{ 61,-145 },{ 128,-141 },{ 154,-120 },{ 147,-120 },{ 107,-132 },{ 47,-139 },{ -17,-141 },{ -71,-142 },{ -149,-128 },{ -176,-145 },{ -189,-164 },{ -188,-199 },{ -183,-243 },{ -206,-268 },{ -223,-221 },{ -214,-183 },{ -214,-154 },{ -221,-139 },{ -253,-73 },{ -257,18 },{ -203,150 },{ -134,207 },{ 38,227 },{ 105,218 },{ -18,239 },{ -138,161 },{ -206,59 },{ -225,-48 },{ -209,-123 },{ -198,-138 },{ -190,-153 },{ -176,-181 },{ -171,-206 },{ -171,-221 },{ -172,-234 },{ -171,-239 },{ -170,-248 },{ -170,-250 },{ -170,-255 },{ -170,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -174,-256 },{ -177,-256 },{ -181,-255 },{ -182,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -196,-254 },{ -196,-254 },{ -202,-254 },{ -203,-254 },{ -218,-254 },{ -218,-254 },{ -226,-254 },{ -226,-254 },{ -233,-254 },{ -233,-254 },{ -247,-254 },{ -247,-254 },{ -250,-254 },{ -250,-254 },{ -253,-254 },{ -253,-254 },{ -262,-254 },{ -262,-254 },{ -267,-254 },{ -267,-254 },{ -281,-256 },{ -281,-256 },{ -302,-258 },{ -302,-258 },{ -314,-258 },{ -316,-258 },{ -322,-258 },{ -322,-258 },{ -326,-258 },{ -330,-254 },{ -332,-254 },{ -340,-247 },{ -344,-243 },{ -347,-239 },{ -350,-236 },{ -354,-233 },{ -359,-228 },{ -364,-222 },{ -367,-214 },{ -369,-210 },{ -370,-207 },{ -372,-198 },{ -374,-189 },{ -374,-174 },{ -375,-168 },{ -377,-156 },{ -378,-148 },{ -378,-139 },{ -379,-116 },{ -379,-93 },{ -376,-72 },{ -369,-59 },{ -356,-49 },{ -344,-43 },{ -329,-43 },{ -314,-46 },{ -305,-48 },{ -288,-50 },{ -275,-58 },{ -263,-81 },{ -249,-123 },{ -243,-140 },{ -240,-161 },{ -237,-183 },{ -247,-216 },{ -261,-236 },{ -270,-255 },{ -266,-271 },{ -234,-278 },{ -220,-278 },{ -203,-275 },{ -183,-268 },{ -173,-260 },{ -170,-242 },{ -175,-223 },{ -182,-200 },{ -209,-196 },{ -242,-214 },{ -262,-223 },{ -301,-226 },{ -320,-224 },{ -344,-213 },{ -370,-185 },{ -373,-152 },{ -373,-122 },{ -373,-100 },{ -370,-73 },{ -367,-57 },{ -364,-35 },{ -355,-11 },{ -344,10 },{ -334,30 },{ -320,44 },{ -309,63 },{ -300,82 },{ -288,92 },{ -260,104 },{ -239,115 },{ -227,121 },{ -191,142 },{ -151,174 },{ -126,192 },{ -102,206 },{ -86,201 },{ -88,167 },{ -170,145 },{ -187,189 },{ -166,218 },{ -126,239 },{ -97,254 },{ -70,262 },{ -8,263 },{ 34,261 },{ 55,257 },{ 79,246 },{ 100,223 },{ 116,200 },{ 134,182 },{ 152,169 },{ 183,169 },{ 212,205 },{ 220,240 },{ 207,267 },{ 134,286 },{ 32,271 },{ -4,256 },{ -25,233 },{ -28,217 },{ 34,198 },{ 106,183 },{ 174,150 },{ 258,107 },{ 323,86 },{ 352,45 },{ 363,-29 },{ 327,-68 },{ 231,6 },{ 304,108 },{ 315,7 },{ 233,-9 },{ 290,87 },{ 348,40 },{ 354,10 },{ 299,-28 },{ 243,16 },{ 278,76 },{ 347,54 },{ 367,-12 },{ 337,-42 },{ 246,-75 },{ 198,-143 },{ 195,-177 },{ 239,-213 },{ 282,-234 },{ 318,-253 },{ 366,-250 },{ 364,-229 },{ 331,-240 },{ 345,-267 },{ 299,-279 },{ 235,-274 },{ 207,-274 },{ 175,-264 },{ 190,-243 },{ 233,-257 },{ 221,-272 },{ 193,-259 },{ 211,-237 },{ 228,-228 },{ 217,-200 },{ 174,-200 },{ 196,-229 },{ 211,-192 },{ 194,-178 },{ 146,-156 },{ 182,-130 },{ 197,-143 },{ 185,-182 },{ 142,-183 },{ 126,-162 },{ 102,-158 },{ 107,-179 },{ 91,-186 },{ 7,-207 },{ -88,-200 },{ -161,-185 },{ -107,-167 },{ -107,-223 },{ -98,-198 },{ -96,-254 },{ -87,-196 },{ -57,-215 },{ -48,-244 },{ -17,-243 },{ 37,-222 },{ 110,-230 },{ 158,-246 },{ 168,-218 },{ 161,-176 },{ 114,-165 },{ 19,-162 },{ -42,-159 },{ -110,-159 },{ -168,-154 },{ -198,-146 },{ -201,-137 },{ -178,-134 },{ -135,-140 },{ -40,-145 },{ 13,-143 },{ 86,-146 },{ 142,-146 },{ 177,-142 },{ 183,-130 },{ 159,-124 },{ 129,-138 },{ 84,-153 },{ 21,-153 },{ -45,-150 },{ -85,-146 },{ -115,-145 },{ -142,-143 },{ -161,-139 },{ -150,-137 },{ -117,-138 },{ -101,-141 },{ -81,-140 },{ -51,-142 },{ -1,-144 },{ 39,-144 },{ 72,-146 },{ 124,-149 },{ 159,-146 },{ 157,-137 },{ 115,-136 },{ 90,-154 },{ 71,-130 },{ 118,-143 },{ 95,-155 },{ 40,-147 },{ 66,-126 },{ 108,-133 },{ 85,-149 },{ 1,-148 },{ 27,-126 },{ 42,-153 },{ -48,-148 },{ 2,-130 },{ -31,-154 },{ -84,-134 },{ -68,-134 },{ -119,-153 },{ -112,-130 },{ -138,-146 },{ -123,-142 },{ -155,-133 },{ -158,-141 },{ -113,-122 },{ -72,-126 },{ -21,-136 },{ 15,-139 },{ 61,-145 },{ 128,-141 },{ 154,-120 },{ 147,-120 },{ 107,-132 },{ 47,-139 },{ -17,-141 },{ -71,-142 },{ -149,-128 },{ -176,-145 },{ -189,-164 },{ -188,-199 },{ -183,-243 },{ -206,-268 },{ -223,-221 },{ -214,-183 },{ -214,-154 },{ -221,-139 },{ -253,-73 },{ -257,18 },{ -203,150 },{ -134,207 },{ 38,227 },{ 105,218 },{ -18,239 },{ -138,161 },{ -206,59 },{ -225,-48 },{ -209,-123 },{ -198,-138 },{ -190,-153 },{ -176,-181 },{ -171,-206 },{ -171,-221 },{ -172,-234 },{ -171,-239 },{ -170,-248 },{ -170,-250 },{ -170,-255 },{ -170,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -169,-256 },{ -174,-256 },{ -177,-256 },{ -181,-255 },{ -182,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -185,-255 },{ -196,-254 },{ -196,-254 },{ -202,-254 },{ -203,-254 },{ -218,-254 },{ -218,-254 },{ -226,-254 },{ -226,-254 },{ -233,-254 },{ -233,-254 },{ -247,-254 },{ -247,-254 },{ -250,-254 },{ -250,-254 },{ -253,-254 },{ -253,-254 },{ -262,-254 },{ -262,-254 },{ -267,-254 },{ -267,-254 },{ -281,-256 },{ -281,-256 },{ -302,-258 },{ -302,-258 },{ -314,-258 },{ -316,-258 },{ -322,-258 },{ -322,-258 },{ -326,-258 },{ -326,-258 } };
-	std::cout << "Number of moving positions: " << positions.size() << std::endl;
-	for (int i = 0; i < 10; i++)
-		genMovingCircle(positions, (9 - i) + 3, 9 - i, { 1 - i / 9.0f, 0, i / 9.0f }, 10 + (9 - i));
+// loads a scene with a million path points and 100k shapes from both forms and times each part
+int runSceneBenchmark() {
+	SceneText text;
+	TreeRecord tree;
+	text.trees.push_back(tree);
+	for (int i = 0; i < 3; i++) {
+		WaveRecord wave;
+		wave.pos = { 0, -200 - 30.0f * i };
+		text.waves.push_back(wave);
+	}
+	for (int i = 0; i < 100; i++) {
+		EmitterRecord emitter;
+		emitter.kind = i % 2 ? EMIT_TRIANGLES : EMIT_CIRCLES;
+		emitter.pos = randomWorldPosition();
+		emitter.count = 1000;
+		text.emitters.push_back(emitter);
+	}
+	PathRecord path;
+	path.firstPoint = 0;
+	path.pointCount = 1000000;
+	path.moverCount = 10;
+	text.points = lissajous(path.pointCount);
+	text.paths.push_back(path);
+	text.tracking = true;
+	const char *textPath = "scene_benchmark.scene";
+	const char *binaryPath = "scene_benchmark.bin";
+	if (!writeTextScene(text.view(), textPath) || !writeBinaryScene(text.view(), binaryPath)) {
+		std::cerr << "Could not write the benchmark scenes" << std::endl;
+		return 1;
+	}
+	const char *paths[] = { textPath, binaryPath };
+	for (int i = 0; i < 2; i++) {
+		resetScene();
+		MappedFile file;
+		SceneText parsed;
+		SceneView scene;
+		std::string error;
+		time_point<steady_clock> start = steady_clock::now();
+		if (!readScene(paths[i], file, parsed, scene, error)) {
+			std::cerr << "Could not load " << paths[i] << ": " << error << std::endl;
+			return 1;
+		}
+		duration<double, std::milli> readTime = steady_clock::now() - start;
+		start = steady_clock::now();
+		buildScene(scene);
+		duration<double, std::milli> buildTime = steady_clock::now() - start;
+		std::cout << paths[i] << " (" << file.size / 1024 << " KB): read " << readTime.count() << " ms, built "
+			<< world->circles.size() + world->triangles.size() << " shapes and a " << scene.header.pointCount << " point path in " << buildTime.count() << " ms" << std::endl;
+	}
+	resetScene();
+	std::remove(textPath);
+	std::remove(binaryPath);
+	return 0;
+}
 
-	trackingLine = new TrackingLine;
-	drawables.push_back(trackingLine);
-	updateBehaviors.push_back(trackingLine);
-	START_TIME = system_clock::now();
-	CURRENT_TIME = system_clock::now();
+// turns a scene into the other form, the output is binary unless its name ends with .scene
+int convertScene(const char *in, const char *out) {
+	MappedFile file;
+	SceneText text;
+	SceneView scene;
+	std::string error;
+	if (!readScene(in, file, text, scene, error)) {
+		std::cerr << "Could not load scene " << in << ": " << error << std::endl;
+		return 1;
+	}
+	std::string name = out;
+	bool textOutput = name.size() >= 6 && name.compare(name.size() - 6, 6, ".scene") == 0;
+	if (!(textOutput ? writeTextScene(scene, out) : writeBinaryScene(scene, out))) {
+		std::cerr << "Could not write " << out << std::endl;
+		return 1;
+	}
+	return 0;
 }
 
 int main(int argc, char **argv) {
+	unsigned int seed = (unsigned int)time(NULL);
+	bool headless = false;
+	bool selfTest = false;
+	bool scaling = false;
+	bool randomBenchmark = false;
+	bool benchmark = false;
+	bool gridBenchmark = false;
+	int particleCount = 0;
+	bool sceneBenchmark = false;
+	bool rasterBenchmark = false;
+	int rasterWidth = 1920, rasterHeight = 1080;
+	const char *convertInput = NULL;
+	const char *convertOutput = NULL;
+	std::string backend = "software";
+	const char *benchmarkPath = NULL;
+	int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	int frames = -1;
+	const char *imagePath = NULL;
+	const char *tracePath = NULL;
+	const char *exportPath = NULL;
+	const char *recordPath = NULL;
+	const char *replayPath = NULL;
+	int batchWorlds = 0;
+	std::vector<Sweep> sweeps;
+	int exportWidth = W, exportHeight = H, exportRate = 60;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--headless")
+			headless = true;
+		else if (arg == "--frames" && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (arg == "--dump" && i + 1 < argc)
+			imagePath = argv[++i];
+		else if (arg == "--trace" && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (arg == "--fps" && i + 1 < argc)
+			FRAME_RATE_CAP = atof(argv[++i]);
+		else if (arg == "--selftest")
+			selfTest = true;
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (arg == "--scaling")
+			scaling = true;
+		else if (arg == "--bench-random")
+			randomBenchmark = true;
+		else if (arg == "--bench")
+			benchmark = true;
+		else if (arg == "--bench-grid")
+			gridBenchmark = true;
+		else if (arg == "--bench-particles" && i + 1 < argc)
+			particleCount = atoi(argv[++i]);
+		else if (arg == "--bench-scene")
+			sceneBenchmark = true;
+		else if (arg == "--bench-raster")
+			rasterBenchmark = true;
+		else if (arg == "--raster-size" && i + 2 < argc) {
+			rasterWidth = atoi(argv[++i]);
+			rasterHeight = atoi(argv[++i]);
+		}
+		else if (arg == "--scene" && i + 1 < argc)
+			SCENE_PATH = argv[++i];
+		else if (arg == "--lod-quality" && i + 1 < argc)
+			LOD_QUALITY = (float)atof(argv[++i]);
+		else if (arg == "--convert-scene" && i + 2 < argc) {
+			convertInput = argv[++i];
+			convertOutput = argv[++i];
+		}
+		else if (arg == "--no-batching")
+			BATCH_DRAWS = false;
+		else if (arg == "--full-repaint")
+			DIRTY_TRACKING = false;
+		else if (arg == "--backend" && i + 1 < argc)
+			backend = argv[++i];
+		else if (arg == "--bench-output" && i + 1 < argc)
+			benchmarkPath = argv[++i];
+		else if (arg == "--record" && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (arg == "--batch" && i + 1 < argc)
+			batchWorlds = atoi(argv[++i]);
+		else if (arg == "--sweep" && i + 3 < argc) {
+			Sweep sweep = { argv[i + 1], (float)atof(argv[i + 2]), (float)atof(argv[i + 3]) };
+			sweeps.push_back(sweep);
+			i += 3;
+		}
+		else if (arg == "--export" && i + 1 < argc)
+			exportPath = argv[++i];
+		else if (arg == "--export-size" && i + 2 < argc) {
+			exportWidth = atoi(argv[++i]);
+			exportHeight = atoi(argv[++i]);
+		}
+		else if (arg == "--export-fps" && i + 1 < argc)
+			exportRate = std::max(atoi(argv[++i]), 1);
+	}
+	std::string scenePath = findScenePath(SCENE_PATH);
+	SCENE_PATH = scenePath.c_str();
+	srand(seed);
+	mainWorld.seed(seed);
+	jobs.start(threads);
+	if (selfTest)
+		return checkBatchKernels() ? 0 : 1;
+	if (scaling)
+		return runScaling(frames < 0 ? 600 : frames, threads);
+	if (randomBenchmark)
+		return runRandomBenchmark();
+	if (gridBenchmark)
+		return runGridBenchmark();
+	if (convertInput)
+		return convertScene(convertInput, convertOutput);
+	if (sceneBenchmark)
+		return runSceneBenchmark();
+	if (rasterBenchmark)
+		return runRasterBenchmark(frames < 0 ? 60 : frames, rasterWidth, rasterHeight);
+	if (particleCount > 0)
+		return runParticleBenchmark(particleCount, frames < 0 ? 600 : frames);
+	if (benchmark)
+		return runBenchmark(frames < 0 ? 120 : frames, backend, benchmarkPath);
+	if (batchWorlds > 0)
+		return runBatch(batchWorlds, frames < 0 ? 600 : frames, sweeps, seed, benchmarkPath);
+	if (replayPath)
+		return runReplay(replayPath, imagePath, tracePath);
+	if (exportPath)
+		return runExport(frames < 0 ? 600 : frames, exportPath, exportWidth, exportHeight, exportRate);
+	if (headless)
+		return runHeadless(frames < 0 ? 600 : frames, imagePath, tracePath);
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
 	glutInitWindowSize(W, H);
 	glutInitWindowPosition(500, 100);
 	glutCreateWindow("Dancing Tree of Wisdom and the Restless Mover - Off");
+	useRenderer(&glRenderer);
+	if (recordPath) {
+		if (!startRecording(recordPath, seed)) {
+			std::cerr << "Could not write " << recordPath << std::endl;
+			return 1;
+		}
+		std::cout << "Recording input to " << recordPath << " with seed " << seed << std::endl;
+	}
 	initialize();
 	glutMainLoop();
 	return 0;